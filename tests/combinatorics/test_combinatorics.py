@@ -9,5 +9,14 @@ def test_combinatorics():
     assert w.integer_partitions(3, 1) == [[3]]
 
 
+def test_bounded_compositions():
+    assert w.bounded_compositions(2, [1, 2]) == [[0, 2], [1, 1]]
+    assert w.bounded_compositions(2, [2, 2]) == [[0, 2], [1, 1], [2, 0]]
+    assert w.bounded_compositions(3, [1, 0, 2]) == [[1, 0, 2]]
+    assert w.bounded_compositions(4, [1, 2]) == []
+    assert w.bounded_compositions(0, [1, 2]) == [[0, 0]]
+
+
 if __name__ == "__main__":
     test_combinatorics()
+    test_bounded_compositions()
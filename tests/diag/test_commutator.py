@@ -0,0 +1,56 @@
+import wicked as w
+
+
+def initialize():
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+
+def test_contract_commutator():
+    """Test the contraction of [H, T] and [[H, T], T]"""
+    initialize()
+    F = w.utils.gen_op("f", 1, "ov", "ov")
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    H = F + V
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+
+    wt = w.WickTheorem()
+    ref = wt.contract(w.commutator(H, T), 0, 4)
+    val = wt.contract_commutator(H, T, 0, 4)
+    assert val == ref
+
+    ref = wt.contract(w.rational(1, 2), w.commutator(w.commutator(H, T), T), 0, 4)
+    val = wt.contract_commutator(w.rational(1, 2), w.commutator(H, T), T, 0, 4)
+    assert val == ref
+
+
+def test_contract_commutator_general():
+    """Test the contraction of a commutator in a general orbital space"""
+    w.reset_space()
+    w.add_space("a", "fermion", "general", ["u", "v", "w", "x", "y", "z"])
+    T2 = w.op("t", ["a+ a+ a a"])
+    V = w.op("v", ["a+ a+ a a"])
+
+    wt = w.WickTheorem()
+    ref = wt.contract(w.commutator(V, T2), 0, 4)
+    val = wt.contract_commutator(V, T2, 0, 4)
+    assert val == ref
+
+
+def test_contract_commutator_odd():
+    """Test the contraction of a commutator of two odd operators"""
+    initialize()
+    A = w.op("A", ["o+", "v"])
+    B = w.op("B", ["o", "v+"])
+
+    wt = w.WickTheorem()
+    ref = wt.contract(w.commutator(A, B), 0, 2)
+    val = wt.contract_commutator(A, B, 0, 2)
+    assert val == ref
+
+
+if __name__ == "__main__":
+    test_contract_commutator()
+    test_contract_commutator_general()
+    test_contract_commutator_odd()
@@ -0,0 +1,56 @@
+import wicked as w
+
+
+def initialize():
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+
+def test_connected_bch():
+    """Test that generating only connected contractions gives the same CCSD Hbar"""
+    initialize()
+    F = w.utils.gen_op("f", 1, "ov", "ov")
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    Hbar = w.bch_series(F + V, T, 4)
+
+    wt = w.WickTheorem()
+    ref = wt.contract(w.rational(1), Hbar, 0, 4)
+
+    wt.set_connected_only(True)
+    val = wt.contract(w.rational(1), Hbar, 0, 4)
+    assert val == ref
+
+
+def test_connected_general():
+    """Test connected contractions of a commutator in a general orbital space"""
+    w.reset_space()
+    w.add_space("a", "fermion", "general", ["u", "v", "w", "x", "y", "z"])
+    T2 = w.op("t", ["a+ a+ a a"])
+    V = w.op("v", ["a+ a+ a a"])
+
+    wt = w.WickTheorem()
+    ref = wt.contract(w.rational(1), w.commutator(V, T2), 0, 4)
+
+    wt.set_connected_only(True)
+    val = wt.contract(w.rational(1), w.commutator(V, T2), 0, 4)
+    assert val == ref
+
+
+def test_connected_product():
+    """Test that disconnected terms of a product are dropped"""
+    initialize()
+    F = w.op("f", ["v+ o"])
+    T = w.op("t", ["v+ o"])
+
+    wt = w.WickTheorem()
+    wt.set_connected_only(True)
+    val = wt.contract(w.rational(1), F @ T, 0, 4)
+    assert val == w.Expression()
+
+
+if __name__ == "__main__":
+    test_connected_bch()
+    test_connected_general()
+    test_connected_product()
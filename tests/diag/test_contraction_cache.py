@@ -0,0 +1,75 @@
+import wicked as w
+
+
+def initialize():
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+
+def test_contraction_cache():
+    """Test that contractions found in the cache give the same result"""
+    initialize()
+    F = w.utils.gen_op("f", 1, "ov", "ov")
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    Hbar = w.bch_series(F + V, T, 2)
+
+    wt = w.WickTheorem()
+    wt.set_use_contraction_cache(True)
+    first = wt.contract(w.rational(1), Hbar, 0, 2)
+    misses = wt.timers()["contraction cache misses"]
+    graph_misses = wt.timers()["contraction graph cache misses"]
+    elementary_misses = wt.timers()["elementary contraction cache misses"]
+    # equivalent contractions have the same canonical graph
+    assert wt.timers()["contraction cache hits"] > 0
+
+    # the second time all contractions are found in the cache
+    second = wt.contract(w.rational(1), Hbar, 0, 2)
+    assert wt.timers()["contraction cache misses"] == misses
+    # and they are not canonicalized again
+    assert wt.timers()["contraction graph cache misses"] == graph_misses
+    assert (
+        wt.timers()["elementary contraction cache misses"] == elementary_misses
+    )
+    assert str(first) == str(second)
+
+    # the cache is off by default
+    wt_nocache = w.WickTheorem()
+    reference = wt_nocache.contract(w.rational(1), Hbar, 0, 2)
+    assert "contraction cache misses" not in wt_nocache.timers()
+    assert str(first) == str(reference)
+
+    # a cache that is too small to hold all the contractions
+    wt_small = w.WickTheorem()
+    wt_small.set_use_contraction_cache(True)
+    wt_small.set_contraction_cache_max_size(4)
+    wt_small.contract(w.rational(1), Hbar, 0, 2)
+    small = wt_small.contract(w.rational(1), Hbar, 0, 2)
+    assert wt_small.timers()["contraction cache misses"] > misses
+    assert str(small) == str(reference)
+
+
+def test_contraction_cache_spaces():
+    """Test that the cache is not used after the orbital spaces change"""
+    initialize()
+    wt = w.WickTheorem()
+    wt.set_use_contraction_cache(True)
+    T = w.op("t", ["v+ o"])
+    V = w.op("v", ["o+ v"])
+    wt.contract(w.rational(1), V @ T, 0, 0)
+
+    # the same product with general orbitals gives different terms
+    w.reset_space()
+    w.add_space("o", "fermion", "general", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "general", ["a", "b", "c", "d", "e", "f"])
+    T = w.op("t", ["v+ o"])
+    V = w.op("v", ["o+ v"])
+    result = wt.contract(w.rational(1), V @ T, 0, 0)
+    reference = w.WickTheorem().contract(w.rational(1), V @ T, 0, 0)
+    assert str(result) == str(reference)
+
+
+if __name__ == "__main__":
+    test_contraction_cache()
+    test_contraction_cache_spaces()
@@ -0,0 +1,44 @@
+import wicked as w
+
+
+def initialize():
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+
+def test_count():
+    """Test counting the contractions of a product of operators"""
+    initialize()
+    F = w.op("f", ["o+ v"])
+    T1 = w.op("t", ["v+ o"])
+
+    wt = w.WickTheorem()
+    counts = wt.count(F @ T1, 0, 4)
+    assert len(counts) == 1
+    ops, rank_counts = counts[0]
+    assert len(ops) == 2
+    assert rank_counts == {0: 1, 2: 2, 4: 1}
+
+    counts = wt.count(F @ T1, 1, 3)
+    assert counts[0][1] == {2: 2}
+
+
+def test_count_expression():
+    """Test counting the contractions of each product of the CCSD Hbar"""
+    initialize()
+    F = w.utils.gen_op("f", 1, "ov", "ov")
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    Hbar = w.bch_series(F + V, T, 2)
+
+    wt = w.WickTheorem()
+    counts = wt.count(Hbar, 0, 0)
+    assert len(counts) == Hbar.size()
+    assert all(set(c.keys()) <= {0} for _, c in counts)
+    assert sum(sum(c.values()) for _, c in counts) > 0
+
+
+if __name__ == "__main__":
+    test_count()
+    test_count_expression()
@@ -0,0 +1,73 @@
+import wicked as w
+
+
+def initialize():
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+
+def test_disk_cache(tmp_path):
+    """Test that results read from the disk cache are equal to the computed ones"""
+    initialize()
+    F = w.utils.gen_op("f", 1, "ov", "ov")
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    Hbar = w.bch_series(F + V, T, 2)
+
+    reference = w.WickTheorem().contract(w.rational(1), Hbar, 0, 2)
+
+    wt = w.WickTheorem()
+    wt.set_disk_cache(str(tmp_path))
+    first = wt.contract(w.rational(1), Hbar, 0, 2)
+    assert "disk cache hits" not in wt.timers()
+    assert str(first) == str(reference)
+
+    # a new object reads all the results from the directory
+    wt2 = w.WickTheorem()
+    wt2.set_disk_cache(str(tmp_path))
+    second = wt2.contract(w.rational(1, 2), Hbar, 0, 2)
+    assert "disk cache misses" not in wt2.timers()
+    assert second == w.WickTheorem().contract(w.rational(1, 2), Hbar, 0, 2)
+
+    # a different rank window is not found in the cache
+    wt2.contract(w.rational(1), Hbar, 0, 0)
+    assert wt2.timers()["disk cache misses"] > 0
+
+
+def test_disk_cache_write_failure(tmp_path):
+    """Test that a disk cache that cannot be written is only skipped"""
+    initialize()
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    reference = w.WickTheorem().contract(w.rational(1), V @ T, 0, 2)
+
+    # the directory cannot be created below a file
+    (tmp_path / "file").write_text("")
+    wt = w.WickTheorem()
+    wt.set_disk_cache(str(tmp_path / "file" / "cache"))
+    assert wt.contract(w.rational(1), V @ T, 0, 2) == reference
+    assert wt.timers()["disk cache write failures"] > 0
+
+    # the files cannot be renamed to paths taken by directories
+    wt = w.WickTheorem()
+    wt.set_disk_cache(str(tmp_path / "cache"))
+    wt.contract(w.rational(1), V @ T, 0, 2)
+    for path in (tmp_path / "cache").glob("*.bin"):
+        path.unlink()
+        path.mkdir()
+        (path / "file").write_text("")
+    wt = w.WickTheorem()
+    wt.set_disk_cache(str(tmp_path / "cache"))
+    assert wt.contract(w.rational(1), V @ T, 0, 2) == reference
+    assert wt.timers()["disk cache write failures"] > 0
+    assert not list((tmp_path / "cache").glob("*.tmp"))
+
+
+if __name__ == "__main__":
+    import tempfile, pathlib
+
+    with tempfile.TemporaryDirectory() as d:
+        test_disk_cache(pathlib.Path(d))
+    with tempfile.TemporaryDirectory() as d:
+        test_disk_cache_write_failure(pathlib.Path(d))
@@ -0,0 +1,47 @@
+import wicked as w
+
+
+def initialize():
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+
+def test_parallel_contract():
+    """Test that contracting the CCSD Hbar with several threads gives the serial result"""
+    initialize()
+    F = w.utils.gen_op("f", 1, "ov", "ov")
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    Hbar = w.bch_series(F + V, T, 4)
+
+    wt = w.WickTheorem()
+    serial = wt.contract(w.rational(1), Hbar, 0, 4)
+
+    wt.set_num_threads(4)
+    assert wt.num_threads() == 4
+    parallel = wt.contract(w.rational(1), Hbar, 0, 4)
+
+    assert serial == parallel
+    assert str(serial) == str(parallel)
+
+
+def test_parallel_contract_product():
+    """Test that splitting the contractions of a single product among threads gives the serial result"""
+    w.reset_space()
+    w.add_space("a", "fermion", "general", ["u", "v", "w", "x", "y", "z"])
+    T2 = w.op("t", ["a+ a+ a a"])
+    V = w.op("v", ["a+ a+ a a"])
+
+    wt = w.WickTheorem()
+    serial = wt.contract(w.rational(1), V @ T2 @ T2, 0, 4)
+
+    wt.set_num_threads(4)
+    parallel = wt.contract(w.rational(1), V @ T2 @ T2, 0, 4)
+
+    assert serial == parallel
+
+
+if __name__ == "__main__":
+    test_parallel_contract()
+    test_parallel_contract_product()
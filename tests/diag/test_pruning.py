@@ -0,0 +1,94 @@
+import wicked as w
+
+
+def initialize():
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+
+def test_pruning_fully_contracted():
+    """Test that the search for fully contracted terms is pruned"""
+    initialize()
+    T2 = w.op("t", ["v+ v+ o o"])
+    V = w.op("v", ["o+ o+ v v", "v+ v+ o o", "o+ v+ v o"])
+
+    wt = w.WickTheorem()
+    val = wt.contract(w.rational(1), V @ T2, 0, 0)
+    val2 = w.expression("1/4 t^{o_0,o_1}_{v_0,v_1} v^{v_0,v_1}_{o_0,o_1}")
+    assert val == val2
+
+    timers = wt.timers()
+    assert timers["step 2 pruned nodes"] > 0
+    assert timers["step 2 pruned nodes"] <= timers["step 2 nodes"]
+    assert timers["step 2 leaves"] + timers["step 2 pruned nodes"] <= timers["step 2 nodes"]
+
+
+def test_pruning_counts_threads():
+    """Test that the number of nodes visited does not depend on the number of
+    threads"""
+    initialize()
+    T2 = w.op("t", ["v+ v+ o o"])
+    V = w.op("v", ["o+ o+ v v", "v+ v+ o o", "o+ v+ v o"])
+
+    counts = []
+    for nthreads in [1, 2, 4]:
+        wt = w.WickTheorem()
+        wt.set_num_threads(nthreads)
+        wt.contract(w.rational(1), V @ T2, 0, 2)
+        timers = wt.timers()
+        counts.append(
+            [
+                timers["step 2 nodes"],
+                timers["step 2 pruned nodes"],
+                timers["step 2 leaves"],
+            ]
+        )
+    assert counts[0] == counts[1] == counts[2]
+
+
+def test_pruning_rank_window():
+    """Test that splitting the range of ranks gives the same result"""
+    initialize()
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    F = w.op("f", ["o+ v", "v+ o", "o+ o", "v+ v"])
+
+    wt = w.WickTheorem()
+    val = wt.contract(w.rational(1), F @ T @ T, 0, 6)
+    val2 = wt.contract(w.rational(1), F @ T @ T, 0, 1)
+    val2 += wt.contract(w.rational(1), F @ T @ T, 2, 3)
+    val2 += wt.contract(w.rational(1), F @ T @ T, 4, 6)
+    assert val == val2
+
+
+def test_pruning_products():
+    """Test that the products that cannot contribute to a range of ranks are
+    removed"""
+    initialize()
+    T = w.op("t", ["v+ o", "v+ v+ o o"])
+    F = w.utils.gen_op("f", 1, "ov", "ov")
+    V = w.utils.gen_op("v", 2, "ov", "ov")
+    Hbar = w.bch_series(F + V, T, 2)
+    Hbar_pruned = w.bch_series(F + V, T, 2, 0, 0)
+    assert Hbar_pruned.size() < Hbar.size()
+
+    wt = w.WickTheorem()
+    val = wt.contract(w.rational(1), Hbar, 0, 0)
+    assert wt.timers()["pruned products"] > 0
+    val2 = w.WickTheorem().contract(w.rational(1), Hbar_pruned, 0, 0)
+    assert val == val2
+
+    # products of excitation operators cannot be fully contracted
+    TT = T @ T
+    TT.prune(0, 0)
+    assert TT.size() == 0
+    TT = T @ T
+    TT.prune(2, 8)
+    assert TT.size() == (T @ T).size()
+
+
+if __name__ == "__main__":
+    test_pruning_fully_contracted()
+    test_pruning_counts_threads()
+    test_pruning_rank_window()
+    test_pruning_products()
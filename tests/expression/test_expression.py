@@ -97,9 +97,67 @@ def test_expression5():
     assert str(expr) == "f^{o0}_{}"
 
 
+def test_expression6():
+    """Test that terms that differ only by the labels of the indices cancel"""
+    w.reset_space()
+    w.add_space("a", "fermion", "general", ["u", "v", "w", "x", "y", "z"])
+    expr = w.expression(
+        "1/4 eta1^{a1}_{a0} eta1^{a3}_{a2} f^{a0,a2}_{a4,a5} gamma1^{a4}_{a6} gamma1^{a5}_{a7} t^{a6,a7}_{a1,a3}"
+    )
+    expr += w.expression(
+        "1/4 eta1^{a1}_{a0} eta1^{a3}_{a2} f^{a0,a2}_{a4,a5} gamma1^{a5}_{a6} gamma1^{a4}_{a7} t^{a6,a7}_{a1,a3}"
+    )
+    assert len(expr) == 2
+    expr.canonicalize()
+    assert len(expr) == 0
+
+
+def test_expression7():
+    """Test that the order of the terms does not depend on how they are added"""
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+    terms = [
+        "f^{o0}_{v0}",
+        "-1/2 t^{v0}_{o0}",
+        "2 f^{o1}_{o0} t^{v0}_{o1}",
+        "g^{v1}_{v0}",
+    ]
+    expr1 = w.Expression()
+    for term in terms:
+        expr1 += w.expression(term)
+    expr2 = w.Expression()
+    for term in reversed(terms):
+        expr2 += w.expression(term)
+    assert expr1 == expr2
+    assert str(expr1) == str(expr2)
+    assert [str(term) for term, _ in expr1] == [str(term) for term, _ in expr2]
+
+
+def test_expression8():
+    """Test that iterating over an expression does not invalidate lookups"""
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+    expr = w.Expression()
+    for term in ["g^{v1}_{v0}", "2 f^{o1}_{o0} t^{v0}_{o1}", "f^{o0}_{v0}"]:
+        expr += w.expression(term)
+    terms = [term for term, _ in expr]
+    assert all(term in expr for term in terms)
+    assert [str(term) for term, _ in expr] == [str(term) for term in terms]
+    assert all(term in expr for term in terms)
+    expr2 = w.Expression()
+    for term in reversed(terms):
+        expr2.add(term)
+    assert [str(term) for term, _ in expr2] == [str(term) for term in terms]
+
+
 if __name__ == "__main__":
     test_expression()
     test_expression2()
     test_expression3()
     test_expression4()
     test_expression5()
+    test_expression6()
+    test_expression7()
+    test_expression8()
@@ -1,3 +1,4 @@
+import pytest
 import wicked as w
 from wicked import Index, index
 
@@ -69,6 +70,20 @@ def test_index2():
     assert sign == w.rational(-1, 1)
 
 
+def test_index3():
+    """Test the range of the positions of an index"""
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c"])
+    assert index("v_4095").pos() == 4095
+    assert index("o_12") < index("o_123") < index("v_0")
+    with pytest.raises(Exception):
+        Index(0, 4096)
+    with pytest.raises(Exception):
+        Index(0, -1)
+
+
 if __name__ == "__main__":
     test_index()
     test_index2()
+    test_index3()
@@ -1,4 +1,5 @@
 import wicked as w
+import pytest
 
 def test_opexpr1():
     """Test the definition of an operator expression"""
@@ -38,7 +39,39 @@ def test_opexpr3():
     op2 = w.op('a', ["v+ o+ v o"])
     assert op1 == op2
 
+def test_opexpr_order():
+    """Test the truncation of products by perturbation order"""
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j", "k", "l", "m", "n"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c", "d", "e", "f"])
+
+    F = w.op("f", ["o+ o", "v+ v"])
+    V = w.op("v", ["o+ v", "v+ o"], order=1)
+    T = w.op("t", ["v+ o"], order=1)
+
+    # products with order greater than maxorder are never formed
+    assert w.product(V, T, 1).size() == 0
+    assert w.product(V, T, 2) == V @ T
+    assert w.product(F, T, 1) == F @ T
+    assert w.commutator(V, T, maxorder=1).size() == 0
+    assert w.commutator(F, T, maxorder=1) == w.commutator(F, T)
+    with pytest.raises(TypeError):
+        w.commutator(V, T, max_order=1)
+
+    # truncating the nested commutators gives the truncated series
+    Hbar = w.bch_series(F + V, T, 3)
+    Hbar.truncate(1)
+    Hbar1 = w.bch_series(F + V, T, 3, maxorder=1)
+    assert Hbar1 == Hbar
+    assert Hbar1.size() < w.bch_series(F + V, T, 3).size()
+
+    wt = w.WickTheorem()
+    val = wt.contract(w.rational(1), Hbar, 0, 0)
+    val1 = wt.contract(w.rational(1), Hbar1, 0, 0)
+    assert val == val1
+
 if __name__ == "__main__":
     test_opexpr1()
     test_opexpr2()
     test_opexpr3()
+    test_opexpr_order()
@@ -46,5 +46,65 @@ def test_rational():
         assert w.make_rational("-/2")
 
 
+def test_rational_overflow():
+    """Test rational numbers that do not fit in 64-bit integers"""
+    x = w.rational(1, 1)
+    for i in range(22):
+        x = x * w.rational(7, 3)
+    if not w.use_boost_1024_int():
+        with pytest.raises(Exception):
+            x * w.rational(7, 3)
+        return
+    y = x * w.rational(7, 3)
+    assert repr(y) == f"rational({7**23},{3**23})"
+    assert y - x != w.rational(0)
+    # the result fits again in 64-bit integers
+    for i in range(23):
+        y = y / w.rational(7, 3)
+    assert y == w.rational(1, 1)
+    assert repr(y) == "rational(1,1)"
+
+
+def test_rational_division_by_zero():
+    """Test that a zero denominator is an error"""
+    with pytest.raises(RuntimeError):
+        w.rational(1, 0)
+    with pytest.raises(RuntimeError):
+        w.rational(1, 2) / w.rational(0)
+    x = w.rational(1, 2)
+    assert x / w.rational(-2) == w.rational(-1, 4)
+    w.set_floating_point_coefficients(True)
+    try:
+        with pytest.raises(RuntimeError):
+            w.rational(1, 2) / w.rational(0)
+    finally:
+        w.set_floating_point_coefficients(False)
+
+
+def test_floating_point_coefficients():
+    """Test rational numbers with floating-point coefficients enabled"""
+    import math
+
+    w.set_floating_point_coefficients(True)
+    try:
+        x = w.rational(1, 3) + w.rational(1, 3)
+        assert x.is_floating_point()
+        assert math.isclose(float(x), 2.0 / 3.0)
+        assert x == w.rational(2, 3)
+        assert x - w.rational(2, 3) == w.rational(0)
+        assert (x * w.rational(3, 2)).str(True) == "+"
+        assert w.rational(-1, 2).str(False) == "-1/2"
+    finally:
+        w.set_floating_point_coefficients(False)
+
+    # the numbers are exact again
+    y = w.rational(1, 3) + w.rational(1, 3)
+    assert not y.is_floating_point()
+    assert repr(y) == "rational(2,3)"
+
+
 if __name__ == "__main__":
     test_rational()
+    test_rational_overflow()
+    test_rational_division_by_zero()
+    test_floating_point_coefficients()
@@ -34,5 +34,33 @@ def test_tensor():
     assert t.latex() == "{T}^{i v}_{a u}"
 
 
+def test_tensor_symmetry():
+    """Test tensors with a user-declared symmetry group"""
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c"])
+
+    # v^{pq}_{rs} = v^{qp}_{sr} = v^{rs}_{pq}
+    w.reset_tensor_symmetries()
+    w.add_tensor_symmetry("v", 2, 2, [([1, 0, 3, 2], 1), ([2, 3, 0, 1], 1)])
+    t = w.tensor("v^{o1,o0}_{v1,v0}", w.sym.none)
+    assert t.canonicalize() == w.rational(1)
+    assert str(t) == "v^{v0,v1}_{o0,o1}"
+
+    # equivalent terms merge
+    expr = w.expression("v^{o0,o1}_{v0,v1} v^{v0,v1}_{o0,o1}", w.sym.none)
+    expr += w.expression("v^{o1,o0}_{v1,v0} v^{v1,v0}_{o1,o0}", w.sym.none)
+    expr += w.expression("v^{o0,o1}_{v1,v0} v^{v1,v0}_{o0,o1}", w.sym.none)
+    expr.canonicalize()
+    assert len(expr) == 1
+
+    # a tensor that vanishes because of its symmetry
+    w.add_tensor_symmetry("g", 2, 2, [([1, 0, 2, 3], -1)])
+    t = w.tensor("g^{o0,o0}_{v1,v0}", w.sym.none)
+    assert t.canonicalize() == w.rational(0)
+    w.reset_tensor_symmetries()
+
+
 if __name__ == "__main__":
     test_tensor()
+    test_tensor_symmetry()
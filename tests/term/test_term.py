@@ -29,5 +29,38 @@ def test_term():
     assert term.latex() == "+\\frac{1}{2} {T}^{i}_{a} \\{ \\hat{a}^{a} \\hat{a}_{i} \\}"
 
 
+def test_term_interning():
+    """Test that interned terms give the same expressions"""
+    w.reset_space()
+    w.add_space("o", "fermion", "occupied", ["i", "j"])
+    w.add_space("v", "fermion", "unoccupied", ["a", "b", "c"])
+
+    terms = [
+        "f^{o0}_{v0} t^{v0}_{o0}",
+        "1/2 f^{o0}_{v0} t^{v0}_{o0} a+(o1) a-(o1)",
+        "v^{o0,o1}_{v0,v1} t^{v0}_{o0} t^{v1}_{o1}",
+    ]
+
+    w.clear_interned_terms()
+    w.set_term_interning(True)
+    interned_expr = w.Expression()
+    for term in terms + terms:
+        interned_expr += w.expression(term)
+    w.set_term_interning(False)
+    # two products of tensors and one product of operators are stored
+    assert w.num_interned_terms() == (2, 1)
+
+    expr = w.Expression()
+    for term in terms:
+        expr += w.expression(term)
+    expr += expr
+    assert len(interned_expr) == 3
+    assert interned_expr == expr
+    assert str(interned_expr) == str(expr)
+    w.clear_interned_terms()
+    assert w.num_interned_terms() == (0, 0)
+
+
 if __name__ == "__main__":
     test_term()
+    test_term_interning()
@@ -14,51 +14,47 @@
 Expression::Expression() : Algebra<SymbolicTerm, scalar_t>() {}
 
 void Expression::add(const Term &sterm) {
-  SymbolicTerm symterm = sterm.symterm();
-  auto search = terms_.find(symterm);
-
-  if (search != terms_.end()) {
-    /// Found, then just add the factor to the existing term
-    search->second += sterm.coefficient();
-    if (search->second == 0) {
-      terms_.erase(search);
-    }
-  } else {
-    terms_[symterm] = sterm.coefficient();
-  }
+  add(std::make_pair(sterm.symterm(), sterm.coefficient()));
+}
+
+void Expression::add(const SymbolicTerm &term, scalar_t coefficient) {
+  if (coefficient == 0)
+    return;
+  add(std::make_pair(term, coefficient));
 }
 
 void Expression::add(const std::pair<SymbolicTerm, scalar_t> &term_factor,
                      scalar_t scale) {
 
-  const SymbolicTerm &term = term_factor.first;
-  scalar_t factor = term_factor.second;
-
-  auto search = terms_.find(term);
-
-  if (search != terms_.end()) {
-    /// Found, then just add the factor to the existing term
-    search->second += scale * factor;
-    if (search->second == 0) {
-      terms_.erase(search);
-    }
-  } else {
-    terms_[term] = scale * factor;
+  // add the factor to the existing term (if found) and remove it if zero
+  if (term_interning()) {
+    SymbolicTerm term = term_factor.first;
+    term.intern();
+    terms_.add(term, scale * term_factor.second);
+    return;
   }
+  terms_.add(term_factor.first, scale * term_factor.second);
 }
 
 void Expression::add(const Expression &expr, scalar_t scale) {
-  for (const auto &kv : expr.terms()) {
+  if (&expr == this) {
+    add(Expression(expr), scale);
+    return;
+  }
+  for (const auto &kv : expr.terms().unsorted()) {
     add(kv, scale);
   }
 }
 
 Expression &Expression::canonicalize() {
-  std::map<SymbolicTerm, scalar_t> canonical_terms;
-  for (const auto &[k, v] : terms_) {
+  vecspace_t canonical_terms;
+  for (const auto &[k, v] : terms_.unsorted()) {
     SymbolicTerm term = k;
     scalar_t factor = term.canonicalize();
     factor *= v;
+    if (term_interning()) {
+      term.intern();
+    }
     add_to_map(canonical_terms, term, factor);
   }
   terms_ = canonical_terms;
@@ -66,8 +62,8 @@ Expression &Expression::canonicalize() {
 }
 
 Expression &Expression::reindex(index_map_t &idx_map) {
-  std::map<SymbolicTerm, scalar_t> reindexed_terms;
-  for (auto &kv : terms_) {
+  vecspace_t reindexed_terms;
+  for (auto &kv : terms_.unsorted()) {
     SymbolicTerm term = kv.first;
     term.reindex(idx_map);
     add_to_map(reindexed_terms, term, kv.second);
@@ -76,8 +72,7 @@ Expression &Expression::reindex(index_map_t &idx_map) {
 }
 
 bool Expression::operator==(const Expression &other) {
-  return (terms_.size() == other.terms_.size()) and
-         std::equal(terms_.begin(), terms_.end(), other.terms_.begin());
+  return terms_ == other.terms_;
 }
 
 std::string Expression::str() const {
@@ -145,10 +140,10 @@ Expression::to_manybody_equation(const std::string &label) const {
     auto signature_str = signature_str_upper + "|" + signature_str_lower;
     lhs.add(lhs_tensor);
 
-    SymbolicTerm rhs;
-    for (const auto &tensor : term.tensors()) {
-      rhs.add(tensor);
-    }
+    // the right-hand side shares the tensors of the term
+    SymbolicTerm rhs(term);
+    rhs.set_normal_ordered(false);
+    rhs.set(std::vector<SQOperator>());
     result[signature_str].push_back(Equation(lhs, rhs, factor));
   }
   return result;
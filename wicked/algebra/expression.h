@@ -10,7 +10,10 @@
 #include "term.h"
 #include "wicked-def.h"
 
-/// A class to represent an algebraic expression
+/// A class to represent an algebraic expression.
+///
+/// The terms added to an expression are interned if term interning is enabled
+/// (see set_term_interning)
 class Expression : public Algebra<SymbolicTerm, scalar_t> {
 public:
   // ==> Constructor <==
@@ -24,7 +27,8 @@ public:
   /// Add a term that can optionally be scaled
   void add(const Term &term);
 
-  using Algebra::add;
+  /// Add a term multiplied by a coefficient. Zero terms are not added
+  void add(const SymbolicTerm &term, scalar_t coefficient = scalar_t(1, 1));
 
   // /// Add a term that can optionally be scaled
   // void add(const SymbolicTerm &term, scalar_t coefficient = 1);
@@ -5,16 +5,15 @@
 #include "helpers/orbital_space.h"
 #include "index.h"
 
-Index::Index() : index_(std::make_pair(-1, -1)) {}
+Index::Index() {}
 
-Index::Index(int space, int p) : index_(std::make_pair(space, p)) {}
-
-bool Index::operator==(Index const &other) const {
-  return index_ == other.index_;
-}
-
-bool Index::operator<(Index const &other) const {
-  return index_ < other.index_;
+Index::Index(int space, int p) {
+  if ((space < 0) or (space >= max_spaces) or (p < 0) or (p >= max_pos)) {
+    throw std::runtime_error("Index::Index - the index (" +
+                             std::to_string(space) + "," + std::to_string(p) +
+                             ") is out of range");
+  }
+  index_ = (space << 12) | p;
 }
 
 std::string Index::str() const {
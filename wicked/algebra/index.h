@@ -1,6 +1,7 @@
 #ifndef _wicked_index_h_
 #define _wicked_index_h_
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -20,6 +21,9 @@
  *
  *     "o_1" -> Index(0,1)
  *
+ * The space and the position are packed into a 16-bit integer (4 bits for the
+ * space and 12 bits for the position), so that indices are compared as
+ * integers and take little memory.
  */
 class Index {
 public:
@@ -30,19 +34,26 @@ public:
 
   // ==> Class public interface <==
 
+  /// The maximum number of spaces and of positions within a space
+  static constexpr int max_spaces = 16;
+  static constexpr int max_pos = 4096;
+
   /// @return the orbital space type
-  int space() const { return index_.first; }
+  int space() const { return index_ >> 12; }
 
   /// @return the position within a space
-  int pos() const { return index_.second; }
+  int pos() const { return index_ & 0xfff; }
 
   /// Comparison operator
   /// @return true if other index is equal to this
-  bool operator==(Index const &other) const;
+  bool operator==(Index const &other) const { return index_ == other.index_; }
 
   /// Less than operator (used for sorting)
   /// @return true if other index is greater to this
-  bool operator<(Index const &other) const;
+  bool operator<(Index const &other) const { return index_ < other.index_; }
+
+  /// @return a hash value (equal indices have equal hashes)
+  std::uint64_t hash() const { return index_; }
 
   /// @return a string representation
   /// (e.g., for index 1 of space 'o' returns 'o1')
@@ -59,8 +70,9 @@ public:
 private:
   // ==> Class private data <==
 
-  /// Store the orbital space type and position in the space (space,p)
-  std::pair<int, int> index_;
+  /// Store the orbital space type and position in the space as
+  /// (space << 12) | p. The default value (all bits set) marks an invalid index
+  std::uint16_t index_ = 0xffff;
 };
 
 // A Index -> Index map used for reindexing
@@ -54,6 +54,11 @@ bool SQOperator::operator==(SQOperator const &other) const {
   return operator_ == other.operator_;
 }
 
+std::uint64_t SQOperator::hash() const {
+  return hash_combine(static_cast<std::uint64_t>(operator_.first),
+                      operator_.second.hash());
+}
+
 std::string SQOperator::str() const {
   std::string s = op_symbol();
   s += (is_creation() ? "+" : "-");
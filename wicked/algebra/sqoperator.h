@@ -22,6 +22,9 @@ public:
   bool operator<(SQOperator const &other) const;
   bool operator==(SQOperator const &other) const;
 
+  /// Return a hash value (equal operators have equal hashes)
+  std::uint64_t hash() const;
+
   /// Return the type of this operator
   SQOperatorType type() const;
 
@@ -1,27 +1,153 @@
 #include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 #include "helpers/combinatorics.h"
 #include "helpers/helpers.h"
 #include "helpers/orbital_space.h"
 #include "helpers/stl_utils.hpp"
 
+#include "tensor_symmetry.h"
 #include "term.h"
 
 using namespace std;
 
+namespace {
+
+/// A table of interned vectors. Each vector is stored once and is shared by
+/// all the terms that contain it. The table may be used by several threads
+template <class T> class InternTable {
+public:
+  using vector_ptr = std::shared_ptr<std::vector<T>>;
+
+  /// Return the interned vector equal to v, adding v if there is none
+  vector_ptr intern(const vector_ptr &v, std::uint64_t hash) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      if (auto found = find(*v, hash))
+        return found;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // the vector may have been added by another thread
+    if (auto found = find(*v, hash))
+      return found;
+    table_.emplace(hash, v);
+    return v;
+  }
+
+  void clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    table_.clear();
+  }
+
+  size_t size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return table_.size();
+  }
+
+private:
+  vector_ptr find(const std::vector<T> &v, std::uint64_t hash) const {
+    auto range = table_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (*it->second == v)
+        return it->second;
+    }
+    return nullptr;
+  }
+
+  std::unordered_multimap<std::uint64_t, vector_ptr> table_;
+  mutable std::shared_mutex mutex_;
+};
+
+InternTable<Tensor> interned_tensors;
+InternTable<SQOperator> interned_ops;
+bool intern_terms = false;
+/// Incremented when the tables are emptied, so that terms interned before are
+/// not compared by pointer with those interned after
+std::uint32_t interned_generation = 1;
+
+const std::vector<SQOperator> no_ops;
+const std::vector<Tensor> no_tensors;
+
+template <class T> std::uint64_t hash_vector(const std::vector<T> &v) {
+  std::uint64_t h = v.size();
+  for (const auto &e : v) {
+    h = hash_combine(h, e.hash());
+  }
+  return h;
+}
+
+} // namespace
+
+void set_term_interning(bool val) { intern_terms = val; }
+
+bool term_interning() { return intern_terms; }
+
+void clear_interned_terms() {
+  interned_tensors.clear();
+  interned_ops.clear();
+  interned_generation++;
+}
+
+std::pair<size_t, size_t> num_interned_terms() {
+  return std::make_pair(interned_tensors.size(), interned_ops.size());
+}
+
 SymbolicTerm::SymbolicTerm() {}
 
 SymbolicTerm::SymbolicTerm(bool normal_ordered,
                            const std::vector<SQOperator> &operators,
                            const std::vector<Tensor> &tensors)
-    : normal_ordered_(normal_ordered), operators_(operators),
-      tensors_(tensors) {}
+    : normal_ordered_(normal_ordered) {
+  set(operators);
+  set(tensors);
+}
+
+const std::vector<SQOperator> &SymbolicTerm::ops() const {
+  return operators_ ? *operators_ : no_ops;
+}
+
+const std::vector<Tensor> &SymbolicTerm::tensors() const {
+  return tensors_ ? *tensors_ : no_tensors;
+}
+
+std::vector<SQOperator> &SymbolicTerm::mutable_ops() {
+  interned_ = 0;
+  if (not operators_) {
+    operators_ = std::make_shared<std::vector<SQOperator>>();
+  } else if (operators_.use_count() > 1) {
+    operators_ = std::make_shared<std::vector<SQOperator>>(*operators_);
+  }
+  return *operators_;
+}
+
+std::vector<Tensor> &SymbolicTerm::mutable_tensors() {
+  interned_ = 0;
+  if (not tensors_) {
+    tensors_ = std::make_shared<std::vector<Tensor>>();
+  } else if (tensors_.use_count() > 1) {
+    tensors_ = std::make_shared<std::vector<Tensor>>(*tensors_);
+  }
+  return *tensors_;
+}
 
 void SymbolicTerm::set_normal_ordered(bool val) { normal_ordered_ = val; }
 
-void SymbolicTerm::set(const std::vector<SQOperator> &op) { operators_ = op; }
+void SymbolicTerm::set(const std::vector<Tensor> &tensors) {
+  interned_ = 0;
+  tensors_ = tensors.empty() ? nullptr
+                             : std::make_shared<std::vector<Tensor>>(tensors);
+}
 
-void SymbolicTerm::add(const SQOperator &op) { operators_.push_back(op); }
+void SymbolicTerm::set(const std::vector<SQOperator> &op) {
+  interned_ = 0;
+  operators_ =
+      op.empty() ? nullptr : std::make_shared<std::vector<SQOperator>>(op);
+}
+
+void SymbolicTerm::add(const SQOperator &op) { mutable_ops().push_back(op); }
 
 void SymbolicTerm::add(const std::vector<SQOperator> &ops) {
   for (const auto &op : ops) {
@@ -29,9 +155,11 @@ void SymbolicTerm::add(const std::vector<SQOperator> &ops) {
   }
 }
 
-void SymbolicTerm::add(const Tensor &tensor) { tensors_.push_back(tensor); }
+void SymbolicTerm::add(const Tensor &tensor) {
+  mutable_tensors().push_back(tensor);
+}
 
-int SymbolicTerm::nops() const { return operators_.size(); }
+int SymbolicTerm::nops() const { return ops().size(); }
 
 // std::vector<Index> SymbolicTerm::indices() const {
 //   std::vector<Index> result;
@@ -46,148 +174,543 @@ int SymbolicTerm::nops() const { return operators_.size(); }
 // }
 
 void SymbolicTerm::reindex(index_map_t &idx_map) {
-  for (auto &t : tensors_) {
+  for (auto &t : mutable_tensors()) {
     t.reindex(idx_map);
   }
-  for (auto &op : operators_) {
+  for (auto &op : mutable_ops()) {
     op.reindex(idx_map);
   }
 }
 
-#define NEW_CANONICALIZATION 1
-scalar_t SymbolicTerm::canonicalize() {
-  scalar_t factor(1);
-
-//
-// 1. Sort the tensors according to a score function
-//
-#if NEW_CANONICALIZATION
-  using score_t =
-      std::tuple<std::string, int, std::vector<int>, std::vector<int>,
-                 std::vector<std::pair<std::string, std::vector<int>>>,
-                 std::vector<std::pair<std::string, std::vector<int>>>, Tensor>;
-#else
-  using score_t =
-      std::tuple<std::string, int, std::vector<int>, std::vector<int>, Tensor>;
-#endif
-
-  std::vector<score_t> scores;
-
-  WPRINT(std::cout << "\n Canonicalizing: " << str() << std::endl;);
+void SymbolicTerm::intern() {
+  if (tensors_) {
+    tensors_ = interned_tensors.intern(tensors_, hash_vector(*tensors_));
+  }
+  if (operators_) {
+    operators_ = interned_ops.intern(operators_, hash_vector(*operators_));
+  }
+  interned_ = interned_generation;
+}
 
-  for (const auto &tensor : tensors_) {
-    // a) label
-    const std::string &label = tensor.label();
+namespace {
+
+/// Encode an orbital index as an integer. The order of the codes is the same
+/// as the order of the Index objects
+inline int index_code(int space, int pos) { return (space << 20) + pos; }
+
+/// Find the canonical form of a SymbolicTerm.
+///
+/// The term is treated as a colored graph whose vertices are the tensors and
+/// the second quantized operators, connected by the orbital indices. The
+/// canonical form is the smallest term (according to SymbolicTerm::operator<)
+/// that can be obtained by relabeling the indices and reordering the tensors
+/// consistently with a score based on invariants of the graph (label, rank,
+/// number of indices per space, and how the indices connect to the other
+/// tensors). The scores are encoded as integers.
+///
+/// The indices are labeled by visiting the tensors in order (lower then upper
+/// indices) and assigning consecutive labels to indices not seen before. For a
+/// given order of the tensors, the labels of the new indices of a tensor can be
+/// permuted without changing that tensor, so the labels are kept in a cell
+/// whose assignment is decided later (partition refinement): when a tensor or
+/// an operator contains some indices of a cell, these receive the smallest
+/// labels of the cell, since this gives the smallest term. Indices that remain
+/// in the same cell are interchangeable. The only choice left is the order of
+/// tensors with equal score (individualization), which is explored with a
+/// search that is pruned as soon as a tensor compares larger than the one in
+/// the same position of the best term found. The indices of a tensor with a
+/// declared symmetry group are not interchangeable, so they are placed one at
+/// a time and the search also explores the arrangements of these tensors.
+class TermCanonicalizer {
+public:
+  TermCanonicalizer(const std::vector<Tensor> &tensors,
+                    const std::vector<SQOperator> &ops);
+
+  void run();
+
+  /// the canonical order of the tensors
+  const std::vector<int> &tensor_order() const { return best_order_; }
+
+  /// the arrangement of the indices of the tensor in position k (the element
+  /// of its symmetry group)
+  int arrangement(int k) const { return best_arrangements_[k]; }
+
+  /// the canonical label of an index
+  Index relabel(const Index &idx) const {
+    return Index(idx.space(), best_labels_[id(idx)]);
+  }
 
-    // b) rank
-    int rank = tensor.rank();
+private:
+  /// The state of the search. The indices are grouped in cells, and each cell
+  /// owns a range of consecutive labels of one space
+  struct State {
+    /// the cell of each index (-1 if the index was not seen)
+    std::vector<int> cell_of;
+    /// the first label of each cell
+    std::vector<int> cell_first;
+    /// the number of labels of each cell
+    std::vector<int> cell_size;
+    /// the number of labels used in each space
+    std::vector<int> sq_count;
+    std::vector<int> tens_count;
+    std::vector<char> placed;
+  };
+
+  const std::vector<Tensor> &tensors_;
+  const std::vector<SQOperator> &ops_;
+  int ntensors_;
+  int nspaces_;
+
+  // the distinct indices of the term and their properties
+  std::vector<Index> indices_;
+  std::vector<char> is_op_index_;
+  /// 0 = creation operator, 1 = annihilation operator, 2 = tensors only
+  std::vector<int> op_type_;
+  std::vector<int> op_ids_;
+  // the indices of the tensors. The lower indices of tensor t are stored in
+  // ids_[begin_[2t]:begin_[2t + 1]] and the upper ones in
+  // ids_[begin_[2t + 1]:begin_[2t + 2]]
+  std::vector<int> ids_;
+  std::vector<int> begin_;
+  // the symmetry group declared for each tensor (if any)
+  std::vector<std::shared_ptr<const TensorSymmetryGroup>> groups_;
+
+  // the class of tensors with the same score that can occupy each position
+  std::vector<int> position_class_;
+  std::vector<int> tensor_class_;
+
+  // the current path of the search (one state per position)
+  std::vector<State> states_;
+  std::vector<int> order_;
+  std::vector<int> arrangements_;
+  std::vector<std::vector<int>> forms_;
+
+  // scratch space
+  std::vector<char> mark_;
+  std::vector<int> cell_count_;
+  std::vector<int> new_cell_;
+  std::vector<int> touched_;
+  std::vector<int> labels_;
+  std::vector<int> op_keys_;
+
+  // the best term found
+  std::vector<int> best_order_;
+  std::vector<int> best_arrangements_;
+  std::vector<std::vector<int>> best_forms_;
+  std::vector<int> best_op_keys_;
+  std::vector<int> best_labels_;
+  int nupdates_ = 0;
+
+  int id(const Index &idx) const {
+    return std::lower_bound(indices_.begin(), indices_.end(), idx) -
+           indices_.begin();
+  }
 
-    // c) number of indices per space
-    std::vector<int> num_low = num_indices_per_space(tensor.lower());
-    std::vector<int> num_upp = num_indices_per_space(tensor.upper());
+  void compute_classes();
+  void place_side(State &st, const int *first, const int *last,
+                  std::vector<int> &form);
+  void place_tensor(State &st, int t, int arrangement, std::vector<int> &form);
+  void search(int k, bool improved);
+  void process_leaf(State &st, bool improved);
+};
+
+TermCanonicalizer::TermCanonicalizer(const std::vector<Tensor> &tensors,
+                                     const std::vector<SQOperator> &ops)
+    : tensors_(tensors), ops_(ops), ntensors_(tensors.size()),
+      nspaces_(orbital_subspaces->num_spaces()) {
+  for (const auto &t : tensors_) {
+    indices_.insert(indices_.end(), t.lower().begin(), t.lower().end());
+    indices_.insert(indices_.end(), t.upper().begin(), t.upper().end());
+  }
+  for (const auto &op : ops_) {
+    indices_.push_back(op.index());
+  }
+  std::sort(indices_.begin(), indices_.end());
+  indices_.erase(std::unique(indices_.begin(), indices_.end()),
+                 indices_.end());
+
+  is_op_index_.assign(indices_.size(), false);
+  op_type_.assign(indices_.size(), 2);
+  for (const auto &op : ops_) {
+    op_ids_.push_back(id(op.index()));
+    is_op_index_[op_ids_.back()] = true;
+    op_type_[op_ids_.back()] = op.is_creation() ? 0 : 1;
+  }
+  begin_.push_back(0);
+  for (const auto &t : tensors_) {
+    groups_.push_back(
+        find_tensor_symmetry(t.label_id(), t.upper().size(), t.lower().size()));
+    for (const auto *side : {&t.lower(), &t.upper()}) {
+      for (const auto &idx : *side) {
+        ids_.push_back(id(idx));
+      }
+      begin_.push_back(ids_.size());
+    }
+  }
+}
 
-    // d) connectivity of lower indices
-    auto lower_conn = tensor_connectivity(tensor, false);
+void TermCanonicalizer::compute_classes() {
+  position_class_.assign(ntensors_, 0);
+  tensor_class_.assign(ntensors_, 0);
+  if (ntensors_ < 2)
+    return;
+
+  // rank the labels of the tensors
+  std::vector<int> by_label(iota_vector<int>(ntensors_));
+  std::sort(by_label.begin(), by_label.end(), [&](int a, int b) {
+    return tensors_[a].label() < tensors_[b].label();
+  });
+  std::vector<int> label_rank(ntensors_, 0);
+  for (int i = 1; i < ntensors_; i++) {
+    label_rank[by_label[i]] =
+        label_rank[by_label[i - 1]] +
+        (tensors_[by_label[i - 1]].label() < tensors_[by_label[i]].label());
+  }
 
-    // d) connectivity of upper indices
-    auto upper_conn = tensor_connectivity(tensor, true);
+  // The lower and upper indices of a tensor whose symmetry group exchanges
+  // them are not distinguished (they are stored as both lower and upper)
+  std::vector<bool> mixed(ntensors_, false);
+  for (int t = 0; t < ntensors_; t++) {
+    mixed[t] = groups_[t] and groups_[t]->exchanges_upper_lower();
+  }
 
-    // e) store the score
-#if NEW_CANONICALIZATION
-    scores.push_back(std::make_tuple(label, rank, num_low, num_upp, lower_conn,
-                                     upper_conn, tensor));
-    WPRINT(
-        std::cout << "\nScore = " << label << " " << rank << " ";
-        PRINT_ELEMENTS(num_low); std::cout << " "; PRINT_ELEMENTS(num_upp);
-        std::cout << " "; for (const auto &str_vec
-                               : lower_conn) {
-          std::cout << str_vec.first << " ";
-          PRINT_ELEMENTS(str_vec.second);
-        } for (const auto &str_vec
-               : upper_conn) {
-          std::cout << " " << str_vec.first << " ";
-          PRINT_ELEMENTS(str_vec.second);
-        });
+  // the number of lower/upper indices that a tensor has in common with each
+  // other tensor, per space
+  std::vector<int> common(ntensors_ * nspaces_);
+  std::vector<std::vector<int>> tensors_of(2 * indices_.size());
+  for (int t = 0; t < ntensors_; t++) {
+    for (int upper = 0; upper < 2; upper++) {
+      for (int i = begin_[2 * t + upper]; i < begin_[2 * t + upper + 1]; i++) {
+        tensors_of[2 * ids_[i] + upper].push_back(t);
+        if (mixed[t]) {
+          tensors_of[2 * ids_[i] + 1 - upper].push_back(t);
+        }
+      }
+    }
+  }
 
-#else
-    scores.push_back(std::make_tuple(label, rank, num_low, num_upp, tensor));
-#endif
-  }
-
-  // sort and rearrange tensors
-  std::sort(scores.begin(), scores.end());
-  tensors_.clear();
-  for (const auto &score : scores) {
-#if NEW_CANONICALIZATION
-    tensors_.push_back(std::get<6>(score));
-#else
-    tensors_.push_back(std::get<4>(score));
-#endif
-  }
-
-  // 2. Relabel indices of tensors and operators
-  // vector to keep track of how many indices in each space
-  std::vector<int> sqop_index_count(orbital_subspaces->num_spaces(), 0);
-  // vector to keep track of how many indices in each space
-  std::vector<int> tens_index_count(orbital_subspaces->num_spaces(), 0);
-  index_map_t index_map;
-  std::map<Index, bool> is_operator_index;
-
-  // a. Assign indices to free operators
-  for (const auto &sqop : operators_) {
-    tens_index_count[sqop.index().space()] += 1;
-    is_operator_index[sqop.index()] = true;
-  }
-
-  // b. Assign indices to tensors operators
-  for (const auto &tensor : tensors_) {
-    // lower indices
-    for (const auto &l : tensor.lower()) {
-      if (is_operator_index.count(l) == 0) {
-        // this index is not shared with an operator
-        if (index_map.count(l) == 0) {
-          int s = l.space();
-          index_map[l] = Index(s, tens_index_count[s]);
-          tens_index_count[s] += 1;
+  // The score of a tensor. The connection to another tensor is encoded in one
+  // integer that contains the rank of its label and the number of indices in
+  // common in each space (6 bits each, there are at most 8 spaces)
+  std::vector<std::vector<std::uint64_t>> scores(ntensors_);
+  std::vector<std::uint64_t> conn;
+  for (int t = 0; t < ntensors_; t++) {
+    auto &score = scores[t];
+    score.push_back(label_rank[t]);
+    score.push_back(tensors_[t].rank());
+    score.resize(2 + 2 * nspaces_, 0);
+    for (int upper = 0; upper < 2; upper++) {
+      const int offset = 2 + (mixed[t] ? 0 : upper * nspaces_);
+      for (int i = begin_[2 * t + upper]; i < begin_[2 * t + upper + 1]; i++) {
+        score[offset + indices_[ids_[i]].space()] += 1;
+      }
+    }
+    // connectivity of the lower (upper) indices to the upper (lower) indices
+    // of the other tensors
+    for (int upper = 0; upper < 2; upper++) {
+      std::fill(common.begin(), common.end(), 0);
+      for (int side = 0; side < 2; side++) {
+        if ((side != upper) and (not mixed[t]))
+          continue;
+        for (int i = begin_[2 * t + side]; i < begin_[2 * t + side + 1]; i++) {
+          const int x = ids_[i];
+          for (int u : tensors_of[2 * x + 1 - upper]) {
+            common[u * nspaces_ + indices_[x].space()] += 1;
+          }
         }
-      } else {
-        // this index is shared with an operator
-        if (index_map.count(l) == 0) {
-          int s = l.space();
-          index_map[l] = Index(s, sqop_index_count[s]);
-          sqop_index_count[s] += 1;
+      }
+      conn.clear();
+      for (int u = 0; u < ntensors_; u++) {
+        if ((u == t) or ((groups_[t] == nullptr) and
+                         (label_rank[u] == label_rank[t]) and
+                         (tensors_[u] == tensors_[t])))
+          continue;
+        std::uint64_t code = label_rank[u];
+        for (int s = 0; s < nspaces_; s++) {
+          code = (code << 6) + std::min(common[u * nspaces_ + s], 63);
         }
+        conn.push_back(code);
       }
+      std::sort(conn.begin(), conn.end());
+      score.insert(score.end(), conn.begin(), conn.end());
     }
-    // upper indices
-    for (const auto &u : tensor.upper()) {
-      if (is_operator_index.count(u) == 0) {
-        if (index_map.count(u) == 0) {
-          int s = u.space();
-          index_map[u] = Index(s, tens_index_count[s]);
-          tens_index_count[s] += 1;
-        }
-      } else {
-        if (index_map.count(u) == 0) {
-          int s = u.space();
-          index_map[u] = Index(s, sqop_index_count[s]);
-          sqop_index_count[s] += 1;
+  }
+
+  // sort the tensors and find the classes of tensors with equal scores
+  std::vector<int> sorted(iota_vector<int>(ntensors_));
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [&](int a, int b) { return scores[a] < scores[b]; });
+  for (int k = 1; k < ntensors_; k++) {
+    position_class_[k] = position_class_[k - 1] +
+                         (scores[sorted[k - 1]] < scores[sorted[k]] ? 1 : 0);
+  }
+  for (int k = 0; k < ntensors_; k++) {
+    tensor_class_[sorted[k]] = position_class_[k];
+  }
+}
+
+void TermCanonicalizer::place_side(State &st, const int *first,
+                                   const int *last, std::vector<int> &form) {
+  // mark the indices already seen (1) and the new ones (2)
+  touched_.clear();
+  for (const int *p = first; p != last; p++) {
+    const int x = *p;
+    if (mark_[x])
+      continue;
+    const int c = st.cell_of[x];
+    mark_[x] = (c >= 0) ? 1 : 2;
+    if (c >= 0) {
+      if (cell_count_[c] == 0) {
+        touched_.push_back(c);
+      }
+      cell_count_[c] += 1;
+    }
+  }
+
+  // indices already seen take the smallest labels of their cell and are moved
+  // to a new cell
+  for (int c : touched_) {
+    const int m = cell_count_[c];
+    new_cell_[c] = st.cell_first.size();
+    st.cell_first.push_back(st.cell_first[c]);
+    st.cell_size.push_back(m);
+    st.cell_first[c] += m;
+    st.cell_size[c] -= m;
+  }
+  for (const int *p = first; p != last; p++) {
+    const int x = *p;
+    if (mark_[x] == 1) {
+      const int c = st.cell_of[x];
+      cell_count_[c] -= 1;
+      st.cell_of[x] = new_cell_[c];
+      form.push_back(index_code(indices_[x].space(),
+                                st.cell_first[new_cell_[c]] + cell_count_[c]));
+      mark_[x] = 3;
+    }
+  }
+
+  // new indices receive the next labels. Indices that appear in an operator
+  // and the other ones are assigned to different cells
+  for (int s = 0; s < nspaces_; s++) {
+    for (int is_op = 1; is_op >= 0; is_op--) {
+      int c = -1;
+      auto &count = is_op ? st.sq_count[s] : st.tens_count[s];
+      for (const int *p = first; p != last; p++) {
+        const int x = *p;
+        if ((mark_[x] == 2) and (indices_[x].space() == s) and
+            (is_op_index_[x] == is_op)) {
+          if (c < 0) {
+            c = st.cell_first.size();
+            st.cell_first.push_back(count);
+            st.cell_size.push_back(0);
+          }
+          st.cell_size[c] += 1;
+          st.cell_of[x] = c;
+          form.push_back(index_code(s, count));
+          count += 1;
+          mark_[x] = 3;
         }
       }
     }
   }
-  // reindex the tensor
-  reindex(index_map);
 
-  // 3. Sort tensor indices according to canonical form
-  for (auto &tensor : tensors_) {
-    factor *= tensor.canonicalize();
+  // reset the scratch space
+  for (const int *p = first; p != last; p++) {
+    mark_[*p] = 0;
   }
+}
 
-  // 4. Sort operators according to canonical form
-  factor *= canonicalize_sqops(operators_, false);
+void TermCanonicalizer::place_tensor(State &st, int t, int arrangement,
+                                     std::vector<int> &form) {
+  const int *lower = ids_.data() + begin_[2 * t];
+  const int *upper = ids_.data() + begin_[2 * t + 1];
+  const int *end = ids_.data() + begin_[2 * t + 2];
+  if (groups_[t] == nullptr) {
+    // the lower and upper indices are sorted separately
+    place_side(st, lower, upper, form);
+    const size_t nlower = form.size();
+    place_side(st, upper, end, form);
+    std::sort(form.begin(), form.begin() + nlower);
+    std::sort(form.begin() + nlower, form.end());
+    return;
+  }
+
+  // The indices of a tensor with a symmetry group are placed one at a time,
+  // lower indices first, in the order given by the permutation. The group
+  // numbers the upper indices first
+  const auto &perm = groups_[t]->elements()[arrangement].first;
+  const int nupper = end - upper;
+  const int n = perm.size();
+  for (int i = 0; i < n; i++) {
+    const int slot = perm[(i + nupper) % n];
+    const int *x = (slot < nupper) ? upper + slot : lower + (slot - nupper);
+    place_side(st, x, x + 1, form);
+  }
+}
+
+void TermCanonicalizer::run() {
+  compute_classes();
+
+  // each index is assigned a cell at most once per tensor side or operator
+  const size_t max_cells = ids_.size() + op_ids_.size();
+  State st;
+  st.cell_of.assign(indices_.size(), -1);
+  st.cell_first.reserve(max_cells);
+  st.cell_size.reserve(max_cells);
+  st.sq_count.assign(nspaces_, 0);
+  st.tens_count.assign(nspaces_, 0);
+  st.placed.assign(ntensors_, false);
+  for (int x : op_ids_) {
+    st.tens_count[indices_[x].space()] += 1;
+  }
+  states_.assign(ntensors_ + 1, st);
+
+  mark_.assign(indices_.size(), 0);
+  cell_count_.assign(max_cells, 0);
+  new_cell_.assign(max_cells, -1);
+  labels_.assign(indices_.size(), 0);
+  order_.assign(ntensors_, -1);
+  arrangements_.assign(ntensors_, 0);
+  forms_.assign(ntensors_, std::vector<int>());
+  search(0, false);
+}
+
+void TermCanonicalizer::search(int k, bool improved) {
+  if (k == ntensors_) {
+    process_leaf(states_[k], improved);
+    return;
+  }
+
+  for (int t = 0; t < ntensors_; t++) {
+    if (states_[k].placed[t] or (tensor_class_[t] != position_class_[k]))
+      continue;
+
+    // tensors with a declared symmetry group are placed once for each
+    // arrangement of their indices
+    const int narrangements = groups_[t] ? groups_[t]->size() : 1;
+    for (int a = 0; a < narrangements; a++) {
+      State &next = states_[k + 1];
+      next = states_[k];
+      next.placed[t] = true;
+      auto &form = forms_[k];
+      form.clear();
+      place_tensor(next, t, a, form);
+      order_[k] = t;
+      arrangements_[k] = a;
+
+      // compare with the tensor in the same position of the best term
+      bool child_improved = improved;
+      if ((not improved) and (not best_order_.empty())) {
+        if (best_forms_[k] < form)
+          continue;
+        child_improved = form < best_forms_[k];
+      }
+
+      const int nupdates = nupdates_;
+      search(k + 1, child_improved);
+      // if a better term was found, it has the same tensors as the current
+      // one up to this position
+      if (nupdates_ != nupdates)
+        improved = false;
+    }
+  }
+}
+
+void TermCanonicalizer::process_leaf(State &st, bool improved) {
+  // operators whose index is not found in any tensor receive new labels
+  for (int type = 0; type < 2; type++) {
+    for (int x : op_ids_) {
+      if ((st.cell_of[x] < 0) and (op_type_[x] == type)) {
+        st.cell_of[x] = st.cell_first.size();
+        st.cell_first.push_back(st.sq_count[indices_[x].space()]++);
+        st.cell_size.push_back(1);
+      }
+    }
+  }
+
+  // assign the labels of each cell. The indices of creation operators take
+  // the smallest labels, since these come first in the canonical order
+  auto &next_label = st.cell_first;
+  const int nindices = indices_.size();
+  for (int type = 0; type < 3; type++) {
+    for (int x = 0; x < nindices; x++) {
+      if (op_type_[x] == type) {
+        labels_[x] = next_label[st.cell_of[x]]++;
+      }
+    }
+  }
+
+  // the operators in canonical order: creation operators with increasing
+  // index followed by annihilation operators with decreasing index
+  op_keys_.clear();
+  for (int x : op_ids_) {
+    const int code = index_code(indices_[x].space(), labels_[x]);
+    op_keys_.push_back((op_type_[x] == 0) ? code : (1 << 30) - code);
+  }
+  std::sort(op_keys_.begin(), op_keys_.end());
+
+  if ((not improved) and (not best_order_.empty())) {
+    if (not(op_keys_ < best_op_keys_))
+      return;
+  }
+  best_order_ = order_;
+  best_arrangements_ = arrangements_;
+  best_forms_ = forms_;
+  best_op_keys_ = op_keys_;
+  best_labels_ = labels_;
+  nupdates_++;
+}
+
+} // namespace
+
+scalar_t SymbolicTerm::canonicalize() {
+  scalar_t factor(1);
+
+  WPRINT(std::cout << "\n Canonicalizing: " << str() << std::endl;);
+
+  // 1. Find the canonical order of the tensors and labels of the indices
+  TermCanonicalizer canonicalizer(tensors(), ops());
+  canonicalizer.run();
+
+  // 2. Reorder the tensors and relabel the indices of tensors and operators
+  std::vector<Tensor> tensors;
+  for (int t : canonicalizer.tensor_order()) {
+    Tensor tensor = this->tensors()[t];
+    std::vector<Index> lower, upper;
+    for (const auto &idx : tensor.lower()) {
+      lower.push_back(canonicalizer.relabel(idx));
+    }
+    for (const auto &idx : tensor.upper()) {
+      upper.push_back(canonicalizer.relabel(idx));
+    }
+    tensor.set_lower(lower);
+    tensor.set_upper(upper);
+    tensors.push_back(tensor);
+  }
+  set(tensors);
+  for (auto &op : mutable_ops()) {
+    op = SQOperator(op.type(), canonicalizer.relabel(op.index()));
+  }
+
+  // 3. Sort tensor indices according to canonical form. The indices of
+  // tensors with a symmetry group are arranged as found by the canonicalizer
+  auto &canonical_tensors = mutable_tensors();
+  for (int k = 0, ntensors = canonical_tensors.size(); k < ntensors; k++) {
+    auto &tensor = canonical_tensors[k];
+    const auto group = find_tensor_symmetry(
+        tensor.label_id(), tensor.upper().size(), tensor.lower().size());
+    if (group) {
+      std::vector<Index> upper(tensor.upper()), lower(tensor.lower());
+      factor *= group->arrange(canonicalizer.arrangement(k), upper, lower);
+      tensor.set_upper(upper);
+      tensor.set_lower(lower);
+    } else {
+      factor *= tensor.canonicalize();
+    }
+  }
 
-  simplify();
+  // 4. Sort operators according to canonical form
+  factor *= canonicalize_sqops(mutable_ops(), false);
 
   WPRINT(std::cout << "\n  " << str();)
 
@@ -203,7 +726,7 @@ scalar_t SymbolicTerm::simplify() {
 
     std::vector<std::vector<Index>> equivalent_classes;
     std::vector<std::pair<std::bitset<64>, std::bitset<64>>> ul_bit_masks;
-    for (const auto &tensor : tensors_) {
+    for (const auto &tensor : tensors()) {
       std::bitset<64> upper_bits, lower_bits;
       {
         std::vector<Index> equivalent;
@@ -245,28 +768,42 @@ scalar_t SymbolicTerm::simplify() {
 }
 
 bool SymbolicTerm::operator<(const SymbolicTerm &other) const {
-  if (tensors_ > other.tensors_) {
-    return false;
-  }
-  if (tensors_ < other.tensors_) {
-    return true;
+  // shared tensors/operators are equal
+  if (tensors_ != other.tensors_) {
+    if (tensors() > other.tensors()) {
+      return false;
+    }
+    if (tensors() < other.tensors()) {
+      return true;
+    }
   }
-  return operators_ < other.operators_;
+  return (operators_ != other.operators_) and (ops() < other.ops());
 }
 
 bool SymbolicTerm::operator==(const SymbolicTerm &other) const {
-  return (tensors_ == other.tensors_) and (operators_ == other.operators_);
+  // terms interned in the same table are equal only if they share the tensors
+  // and the operators
+  if ((interned_ != 0) and (interned_ == other.interned_)) {
+    return (tensors_ == other.tensors_) and (operators_ == other.operators_);
+  }
+  return ((tensors_ == other.tensors_) or (tensors() == other.tensors())) and
+         ((operators_ == other.operators_) or (ops() == other.ops()));
+}
+
+std::uint64_t SymbolicTerm::hash() const {
+  // normal_ordered_ is not hashed since it is not compared by operator==
+  return hash_combine(hash_vector(tensors()), hash_vector(ops()));
 }
 
 std::string SymbolicTerm::str() const {
   std::vector<std::string> str_vec;
-  for (const Tensor &tensor : tensors_) {
+  for (const Tensor &tensor : tensors()) {
     str_vec.push_back(tensor.str());
   }
   if (nops()) {
     if (normal_ordered())
       str_vec.push_back("{");
-    for (const auto &op : operators_) {
+    for (const auto &op : ops()) {
       str_vec.push_back(op.str());
     }
     if (normal_ordered())
@@ -278,13 +815,13 @@ std::string SymbolicTerm::str() const {
 
 std::string SymbolicTerm::latex() const {
   std::vector<std::string> str_vec;
-  for (const Tensor &tensor : tensors_) {
+  for (const Tensor &tensor : tensors()) {
     str_vec.push_back(tensor.latex());
   }
   if (nops()) {
     if (normal_ordered())
       str_vec.push_back("\\{");
-    for (const auto &op : operators_) {
+    for (const auto &op : ops()) {
       str_vec.push_back(op.latex());
     }
     if (normal_ordered())
@@ -296,7 +833,7 @@ std::string SymbolicTerm::latex() const {
 std::string SymbolicTerm::compile(const std::string &format) const {
   if (format == "ambit") {
     std::vector<std::string> str_vec;
-    for (const Tensor &tensor : tensors_) {
+    for (const Tensor &tensor : tensors()) {
       str_vec.push_back(tensor.compile(format));
     }
     if (nops()) {
@@ -318,33 +855,3 @@ std::ostream &operator<<(std::ostream &os,
   os << term_factor.second << ' ' << term_factor.second;
   return os;
 }
-
-std::vector<std::pair<std::string, std::vector<int>>>
-SymbolicTerm::tensor_connectivity(const Tensor &t, bool upper) const {
-  std::vector<std::pair<std::string, std::vector<int>>> result;
-  auto indices = upper ? t.upper() : t.lower();
-  sort(indices.begin(), indices.end());
-  for (const auto &tensor : tensors_) {
-    if (not(t == tensor)) {
-
-      std::vector<Index> indices2 = upper ? tensor.lower() : tensor.upper();
-      sort(indices2.begin(), indices2.end());
-
-      std::vector<Index> indices3 = tensor.upper();
-      sort(indices3.begin(), indices3.end());
-
-      std::vector<Index> common_lower_indices;
-      set_intersection(indices.begin(), indices.end(), indices2.begin(),
-                       indices2.end(), back_inserter(common_lower_indices));
-
-      std::vector<Index> common_upper_indices;
-      set_intersection(indices.begin(), indices.end(), indices3.begin(),
-                       indices3.end(), back_inserter(common_upper_indices));
-
-      result.push_back(std::make_pair(
-          tensor.label(), num_indices_per_space(common_lower_indices)));
-    }
-  }
-  std::sort(result.begin(), result.end());
-  return result;
-}
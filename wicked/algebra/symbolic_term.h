@@ -2,6 +2,7 @@
 #define _wicked_symbolic_term_h_
 
 #include <map>
+#include <memory>
 #include <numeric>
 #include <string>
 #include <vector>
@@ -14,6 +15,11 @@
 /// A class to represent a term in a SQ expression. A term includes:
 /// 1) a product of tensors
 /// 2) a product of operators normal ordered with respect to the vacuum
+///
+/// The tensors and the operators are shared by the copies of a term and are
+/// copied only when one of the copies is modified. Terms with the same tensors
+/// or operators can also be made to share them by interning them (see
+/// set_term_interning).
 class SymbolicTerm {
 public:
   // ==> Constructor <==
@@ -47,10 +53,10 @@ public:
   bool normal_ordered() const { return normal_ordered_; }
 
   /// Return the SQ operators
-  const std::vector<SQOperator> &ops() const { return operators_; }
+  const std::vector<SQOperator> &ops() const;
 
   /// Return the tensors
-  const std::vector<Tensor> &tensors() const { return tensors_; }
+  const std::vector<Tensor> &tensors() const;
 
   /// Apply a re-indexing map to this symbolic term
   void reindex(index_map_t &idx_map);
@@ -69,6 +75,14 @@ public:
   /// Comparison operator used for sorting
   bool operator==(const SymbolicTerm &term) const;
 
+  /// Return a hash value (equal terms have equal hashes)
+  std::uint64_t hash() const;
+
+  /// Replace the tensors and the operators with the equal ones stored in the
+  /// table of interned terms (adding them if necessary). Interned terms are
+  /// compared by pointer
+  void intern();
+
   /// Return a string representation
   std::string str() const;
 
@@ -79,18 +93,35 @@ public:
   std::string compile(const std::string &format) const;
 
 protected:
+  /// Return the operators/tensors for modification. They are copied first if
+  /// they are shared with other terms
+  std::vector<SQOperator> &mutable_ops();
+  std::vector<Tensor> &mutable_tensors();
+
   // ==> Class private data <==
   bool normal_ordered_ = false;
-  std::vector<SQOperator> operators_;
-  std::vector<Tensor> tensors_;
+  /// The generation of the table of interned terms in which this term was
+  /// interned (0 if the term is not interned)
+  std::uint32_t interned_ = 0;
+  std::shared_ptr<std::vector<SQOperator>> operators_;
+  std::shared_ptr<std::vector<Tensor>> tensors_;
+};
 
-  // ==> Class private functions <==
+/// Enable/disable interning of the terms added to an Expression. When enabled,
+/// a product of tensors (or operators) that appears in several terms is
+/// stored only once, and terms are compared by pointer. Disabled by default
+void set_term_interning(bool val);
 
-  // Used in the canonicalization routine to find how the indices of a tensor
-  // connect to all the other tensors
-  std::vector<std::pair<std::string, std::vector<int>>>
-  tensor_connectivity(const Tensor &t, bool upper) const;
-};
+/// Return true if the terms added to an Expression are interned
+bool term_interning();
+
+/// Empty the table of interned terms. Terms that were interned keep their
+/// tensors and operators
+void clear_interned_terms();
+
+/// Return the number of products of tensors and of operators that are
+/// interned
+std::pair<size_t, size_t> num_interned_terms();
 
 // Helper functions
 
@@ -1,16 +1,59 @@
 #include <algorithm>
 #include <iostream>
+#include <mutex>
 #include <regex>
+#include <shared_mutex>
+#include <unordered_map>
 
 #include "helpers/helpers.h"
 #include "helpers/orbital_space.h"
 
 #include "tensor.h"
+#include "tensor_symmetry.h"
 #include "wicked-def.h"
 
+namespace {
+/// The table of tensor labels. Tensors may be created by several threads, so
+/// the table is protected by a mutex
+std::unordered_map<std::string, int> tensor_labels;
+std::shared_mutex tensor_labels_mutex;
+
+/// Find a label in the table of tensor labels, adding it if necessary
+const tensor_label_t *find_tensor_label(const std::string &label) {
+  {
+    std::shared_lock<std::shared_mutex> lock(tensor_labels_mutex);
+    auto it = tensor_labels.find(label);
+    if (it != tensor_labels.end())
+      return &*it;
+  }
+  std::unique_lock<std::shared_mutex> lock(tensor_labels_mutex);
+  // the label may have been added by another thread
+  const int id = tensor_labels.size();
+  return &*tensor_labels.emplace(label, id).first;
+}
+} // namespace
+
+const tensor_label_t *intern_tensor_label(const std::string &label) {
+  // Each thread keeps the entries of the labels it has seen, so that the
+  // shared table is locked only when a thread sees a label for the first time
+  thread_local std::unordered_map<std::string, const tensor_label_t *> seen;
+  auto it = seen.find(label);
+  if (it != seen.end())
+    return it->second;
+  const tensor_label_t *entry = find_tensor_label(label);
+  seen.emplace(label, entry);
+  return entry;
+}
+
+Tensor::Tensor() {
+  static const tensor_label_t *empty_label = intern_tensor_label("");
+  label_ = empty_label;
+}
+
 Tensor::Tensor(const std::string &label, const std::vector<Index> &lower,
                const std::vector<Index> &upper, SymmetryType symmetry)
-    : label_(label), lower_(lower), upper_(upper), symmetry_(symmetry) {}
+    : label_(intern_tensor_label(label)), lower_(lower), upper_(upper),
+      symmetry_(symmetry) {}
 
 std::vector<std::pair<int, int>> Tensor::signature() const {
   std::vector<std::pair<int, int>> result(orbital_subspaces->num_spaces(),
@@ -29,11 +72,9 @@ int Tensor::symmetry_factor() const {
 }
 
 bool Tensor::operator<(Tensor const &other) const {
-  // Compare the labels
-  if (label_ < other.label_)
-    return true;
-  if (label_ > other.label_)
-    return false;
+  // Compare the labels (as strings, since the IDs are in order of creation)
+  if (label_ != other.label_)
+    return label_->first < other.label_->first;
   // Compare the lower indices
   if (lower_ < other.lower_)
     return true;
@@ -47,6 +88,18 @@ bool Tensor::operator==(Tensor const &other) const {
          (upper_ == other.upper_);
 }
 
+std::uint64_t Tensor::hash() const {
+  std::uint64_t h = label_->second;
+  h = hash_combine(h, lower_.size());
+  for (const auto &idx : lower_) {
+    h = hash_combine(h, idx.hash());
+  }
+  for (const auto &idx : upper_) {
+    h = hash_combine(h, idx.hash());
+  }
+  return h;
+}
+
 std::vector<Index> Tensor::indices() const {
   std::vector<Index> vec;
   for (const Index &idx : upper_) {
@@ -75,14 +128,24 @@ void Tensor::reindex(index_map_t &idx_map) {
 }
 
 scalar_t Tensor::canonicalize() {
+  // a declared symmetry group takes precedence over the symmetry type
+  if (const auto group =
+          find_tensor_symmetry(label_id(), upper_.size(), lower_.size())) {
+    std::vector<Index> upper(upper_), lower(lower_);
+    scalar_t sign = group->canonicalize(upper, lower);
+    upper_ = upper;
+    lower_ = lower;
+    return sign;
+  }
   if (symmetry_ == SymmetryType::Nonsymmetric) {
     throw std::runtime_error(
-        "Tensor::canonicalize cannot canonicalize a nonsymmetric tensor");
+        "Tensor::canonicalize cannot canonicalize a nonsymmetric tensor "
+        "without a declared symmetry group (see add_tensor_symmetry)");
   }
   scalar_t sign = 1;
-  auto upper_indices = this->upper();
+  std::vector<Index> upper_indices(upper_);
   sign *= canonicalize_indices(upper_indices, false);
-  auto lower_indices = this->lower();
+  std::vector<Index> lower_indices(lower_);
   sign *= canonicalize_indices(lower_indices, false);
   this->set_upper(upper_indices);
   this->set_lower(lower_indices);
@@ -98,7 +161,7 @@ std::string Tensor::str() const {
   for (const Index &index : lower_) {
     str_vec_lower.push_back(index.str());
   }
-  return (label_ + "^{" + join(str_vec_upper, ",") + "}_{" +
+  return (label() + "^{" + join(str_vec_upper, ",") + "}_{" +
           join(str_vec_lower, ",") + "}");
 }
 
@@ -115,9 +178,10 @@ std::string Tensor::latex() const {
   // read the label. Here we try to separate the name (e.g., lambda) from the
   // subscript (eg. 1). For greek letters we omit the subscript.
   std::smatch sm;
-  auto m = std::regex_match(label_, sm, std::regex("([a-zA-Z]+)[_]?(\\d+)?"));
+  auto m =
+      std::regex_match(label(), sm, std::regex("([a-zA-Z]+)[_]?(\\d+)?"));
   if (not m) {
-    throw std::runtime_error("\nCould not parse tensor label " + label_);
+    throw std::runtime_error("\nCould not parse tensor label " + label());
   }
   std::string symbol = sm[1];
   std::string raw_subscript = sm[2];
@@ -146,8 +210,8 @@ std::string Tensor::compile(const std::string &format) const {
     str_vec.push_back(index.compile(format));
   }
 
-  return (str_vec.size() > 0 ? (label_ + "[" + join(str_vec, ",") + "]")
-                             : label_);
+  return (str_vec.size() > 0 ? (label() + "[" + join(str_vec, ",") + "]")
+                             : label());
 }
 
 std::ostream &operator<<(std::ostream &os, const Tensor &tensor) {
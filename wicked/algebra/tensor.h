@@ -2,21 +2,38 @@
 #define _wicked_tensor_h_
 
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "helpers/small_vector.hpp"
 #include "index.h"
 #include "wicked-def.h"
 
 /// Enums
 enum class SymmetryType { Symmetric, Antisymmetric, Nonsymmetric };
 
+/// The indices of one side (upper or lower) of a tensor. Up to four indices
+/// are stored without allocating memory
+using tensor_indices_t = small_vector<Index, 4>;
+
+/// An entry of the global table of tensor labels: the label and its ID
+using tensor_label_t = std::pair<const std::string, int>;
+
+/// Return the entry of a label in the table of tensor labels, adding it if
+/// necessary. Entries are never removed, so the pointer remains valid
+const tensor_label_t *intern_tensor_label(const std::string &label);
+
 /// This class represents a tensor labeled with orbital indices.
 /// It holds information about the label and the indices of the tensor.
+///
+/// The label is stored as a pointer to its entry in the table of tensor
+/// labels, so that labels are compared for equality without comparing
+/// strings.
 class Tensor {
 
 public:
   // ==> Constructors <==
-  explicit Tensor() {}
+  explicit Tensor();
 
   Tensor(const std::string &label, const std::vector<Index> &lower,
          const std::vector<Index> &upper, SymmetryType symmetry);
@@ -24,13 +41,16 @@ public:
   // ==> Class public interface <==
 
   /// Return a reference to the label
-  const std::string &label() const { return label_; }
+  const std::string &label() const { return label_->first; }
+
+  /// Return the ID of the label in the table of tensor labels
+  int label_id() const { return label_->second; }
 
   /// Return a reference to the lower indices
-  const std::vector<Index> &lower() const { return lower_; }
+  const tensor_indices_t &lower() const { return lower_; }
 
   /// Return a reference to the upper indices
-  const std::vector<Index> &upper() const { return upper_; }
+  const tensor_indices_t &upper() const { return upper_; }
 
   /// Return a reference to the symmetry
   SymmetryType symmetry() const { return symmetry_; }
@@ -47,7 +67,9 @@ public:
   /// Reindex this tensor
   void reindex(index_map_t &idx_map);
 
-  /// Canonicalize this tensor and return the overall phase factor
+  /// Canonicalize this tensor and return the overall phase factor. If a
+  /// symmetry group was declared for this tensor (see add_tensor_symmetry) it
+  /// is used instead of the symmetry type
   scalar_t canonicalize();
 
   /// Return the rank of the tensor
@@ -65,6 +87,9 @@ public:
   /// Comparison operator used for sorting
   bool operator==(Tensor const &other) const;
 
+  /// Return a hash value (equal tensors have equal hashes)
+  std::uint64_t hash() const;
+
   /// Return a string representation
   std::string str() const;
 
@@ -77,9 +102,9 @@ public:
 private:
   // ==> Class private data <==
 
-  std::string label_;
-  std::vector<Index> lower_;
-  std::vector<Index> upper_;
+  const tensor_label_t *label_;
+  tensor_indices_t lower_;
+  tensor_indices_t upper_;
   SymmetryType symmetry_;
 };
 
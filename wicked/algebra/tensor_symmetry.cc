@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "helpers/helpers.h"
+
+#include "tensor.h"
+#include "tensor_symmetry.h"
+
+namespace {
+/// The symmetries declared for a tensor label
+struct LabelSymmetries {
+  std::string label;
+  std::vector<std::shared_ptr<const TensorSymmetryGroup>> groups;
+};
+
+/// The declared symmetries, stored by the ID of the tensor label. Tensors may
+/// be canonicalized by several threads, so the table is protected by a mutex
+std::unordered_map<int, LabelSymmetries> tensor_symmetries;
+std::shared_mutex tensor_symmetries_mutex;
+/// The number of labels with declared symmetries. It is read without locking
+/// the table, so that tensors are canonicalized without locking when no
+/// symmetry is declared
+std::atomic<int> num_tensor_symmetries(0);
+} // namespace
+
+TensorSymmetryGroup::TensorSymmetryGroup(
+    int nupper, int nlower, const std::vector<tensor_permutation_t> &generators)
+    : nupper_(nupper), nlower_(nlower), generators_(generators) {
+  const int n = nupper + nlower;
+  for (const auto &[perm, sign] : generators_) {
+    std::vector<int> sorted_perm(perm);
+    std::sort(sorted_perm.begin(), sorted_perm.end());
+    if (sorted_perm != iota_vector<int>(n)) {
+      throw std::runtime_error(
+          "TensorSymmetryGroup - a generator is not a permutation of the " +
+          std::to_string(n) + " indices of the tensor");
+    }
+    if ((sign != 1) and (sign != -1)) {
+      throw std::runtime_error(
+          "TensorSymmetryGroup - the sign of a generator must be +1 or -1");
+    }
+  }
+
+  // Generate the group by multiplying the elements found by the generators
+  // until no new element is found
+  std::map<std::vector<int>, int> sign_of;
+  elements_.push_back(std::make_pair(iota_vector<int>(n), 1));
+  sign_of[elements_[0].first] = 1;
+  for (size_t k = 0; k < elements_.size(); k++) {
+    const auto [perm, sign] = elements_[k];
+    for (const auto &[gen_perm, gen_sign] : generators_) {
+      std::vector<int> product(n);
+      for (int i = 0; i < n; i++) {
+        product[i] = perm[gen_perm[i]];
+      }
+      const int product_sign = sign * gen_sign;
+      auto it = sign_of.find(product);
+      if (it == sign_of.end()) {
+        sign_of[product] = product_sign;
+        elements_.push_back(std::make_pair(product, product_sign));
+      } else if (it->second != product_sign) {
+        throw std::runtime_error(
+            "TensorSymmetryGroup - the generators are not consistent (a "
+            "permutation is generated with both signs)");
+      }
+    }
+  }
+
+  for (const auto &[perm, sign] : elements_) {
+    for (int i = 0; i < nupper; i++) {
+      if (perm[i] >= nupper) {
+        exchanges_upper_lower_ = true;
+      }
+    }
+  }
+}
+
+scalar_t TensorSymmetryGroup::canonicalize(std::vector<Index> &upper,
+                                           std::vector<Index> &lower) const {
+  if ((static_cast<int>(upper.size()) != nupper_) or
+      (static_cast<int>(lower.size()) != nlower_)) {
+    throw std::runtime_error("TensorSymmetryGroup::canonicalize - the number "
+                             "of indices does not match the group");
+  }
+  std::vector<Index> indices(upper);
+  indices.insert(indices.end(), lower.begin(), lower.end());
+  const int n = indices.size();
+
+  // compare two arrangements in the order used by Tensor::operator<
+  auto less = [&](const std::vector<Index> &a, const std::vector<Index> &b) {
+    for (int i = 0; i < n; i++) {
+      const int k = (i + nupper_) % n;
+      if (a[k] < b[k])
+        return true;
+      if (b[k] < a[k])
+        return false;
+    }
+    return false;
+  };
+
+  // try all the elements of the group
+  std::vector<Index> best(indices), trial(n);
+  int best_sign = 1;
+  for (const auto &[perm, sign] : elements_) {
+    for (int i = 0; i < n; i++) {
+      trial[i] = indices[perm[i]];
+    }
+    if (less(trial, best)) {
+      best.swap(trial);
+      best_sign = sign;
+    }
+  }
+
+  upper.assign(best.begin(), best.begin() + nupper_);
+  lower.assign(best.begin() + nupper_, best.end());
+  return vanishes(best) ? scalar_t(0) : scalar_t(best_sign);
+}
+
+scalar_t TensorSymmetryGroup::arrange(int element, std::vector<Index> &upper,
+                                      std::vector<Index> &lower) const {
+  std::vector<Index> indices(upper);
+  indices.insert(indices.end(), lower.begin(), lower.end());
+  const auto &[perm, sign] = elements_[element];
+  std::vector<Index> arranged(indices.size());
+  for (size_t i = 0; i < indices.size(); i++) {
+    arranged[i] = indices[perm[i]];
+  }
+  upper.assign(arranged.begin(), arranged.begin() + nupper_);
+  lower.assign(arranged.begin() + nupper_, arranged.end());
+  return vanishes(arranged) ? scalar_t(0) : scalar_t(sign);
+}
+
+bool TensorSymmetryGroup::vanishes(const std::vector<Index> &indices) const {
+  const int n = indices.size();
+  for (const auto &[perm, sign] : elements_) {
+    if (sign > 0)
+      continue;
+    int i = 0;
+    while ((i < n) and (indices[perm[i]] == indices[i])) {
+      i++;
+    }
+    if (i == n)
+      return true;
+  }
+  return false;
+}
+
+std::string TensorSymmetryGroup::str() const {
+  std::vector<std::string> str_vec;
+  for (const auto &[perm, sign] : generators_) {
+    std::vector<std::string> perm_str;
+    for (int p : perm) {
+      perm_str.push_back(std::to_string(p));
+    }
+    str_vec.push_back("(" + join(perm_str, ",") + ")" +
+                      (sign > 0 ? "+" : "-"));
+  }
+  return std::to_string(nupper_) + "," + std::to_string(nlower_) + ": " +
+         join(str_vec, " ");
+}
+
+void add_tensor_symmetry(const std::string &label, int nupper, int nlower,
+                         const std::vector<tensor_permutation_t> &generators) {
+  auto group =
+      std::make_shared<const TensorSymmetryGroup>(nupper, nlower, generators);
+  const int label_id = intern_tensor_label(label)->second;
+  std::unique_lock<std::shared_mutex> lock(tensor_symmetries_mutex);
+  auto &[stored_label, groups] = tensor_symmetries[label_id];
+  stored_label = label;
+  for (auto &g : groups) {
+    if ((g->nupper() == nupper) and (g->nlower() == nlower)) {
+      g = group;
+      return;
+    }
+  }
+  groups.push_back(group);
+  num_tensor_symmetries.store(tensor_symmetries.size(),
+                              std::memory_order_release);
+}
+
+void reset_tensor_symmetries() {
+  std::unique_lock<std::shared_mutex> lock(tensor_symmetries_mutex);
+  tensor_symmetries.clear();
+  num_tensor_symmetries.store(0, std::memory_order_release);
+}
+
+std::shared_ptr<const TensorSymmetryGroup>
+find_tensor_symmetry(int label_id, int nupper, int nlower) {
+  if (num_tensor_symmetries.load(std::memory_order_acquire) == 0)
+    return nullptr;
+  std::shared_lock<std::shared_mutex> lock(tensor_symmetries_mutex);
+  auto it = tensor_symmetries.find(label_id);
+  if (it == tensor_symmetries.end())
+    return nullptr;
+  for (const auto &g : it->second.groups) {
+    if ((g->nupper() == nupper) and (g->nlower() == nlower)) {
+      return g;
+    }
+  }
+  return nullptr;
+}
+
+std::string tensor_symmetries_str() {
+  if (num_tensor_symmetries.load(std::memory_order_acquire) == 0)
+    return "";
+  // sort the groups by label, so that the string does not depend on the order
+  // in which the labels were interned
+  std::map<std::string, std::vector<std::string>> sorted;
+  {
+    std::shared_lock<std::shared_mutex> lock(tensor_symmetries_mutex);
+    for (const auto &[label_id, symmetries] : tensor_symmetries) {
+      auto &strs = sorted[symmetries.label];
+      for (const auto &g : symmetries.groups) {
+        strs.push_back(g->str());
+      }
+    }
+  }
+  std::string s;
+  for (const auto &[label, strs] : sorted) {
+    for (const auto &g : strs) {
+      s += label + " " + g + "\n";
+    }
+  }
+  return s;
+}
@@ -0,0 +1,102 @@
+#ifndef _wicked_tensor_symmetry_h_
+#define _wicked_tensor_symmetry_h_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "index.h"
+#include "wicked-def.h"
+
+/// A permutation of the indices of a tensor and its sign. The indices are
+/// numbered as they are printed: first the upper indices and then the lower
+/// ones. The permutation p maps the indices (x_0, x_1, ...) to
+/// (x_p[0], x_p[1], ...), and the tensor changes by the sign (+1 or -1)
+using tensor_permutation_t = std::pair<std::vector<int>, int>;
+
+/// This class represents the group of permutations of the indices of a tensor
+/// that leave it unchanged up to a sign. The group is specified by a set of
+/// generators and all its elements are stored.
+///
+/// For example, a two-electron integral v^{pq}_{rs} that is not antisymmetric
+/// but has pair-exchange and bra-ket symmetry is described by the generators
+///     ({1, 0, 3, 2}, +1)  v^{pq}_{rs} = v^{qp}_{sr}
+///     ({2, 3, 0, 1}, +1)  v^{pq}_{rs} = v^{rs}_{pq}
+class TensorSymmetryGroup {
+public:
+  // ==> Constructors <==
+  TensorSymmetryGroup(int nupper, int nlower,
+                      const std::vector<tensor_permutation_t> &generators);
+
+  // ==> Class public interface <==
+
+  /// Return the number of upper indices
+  int nupper() const { return nupper_; }
+
+  /// Return the number of lower indices
+  int nlower() const { return nlower_; }
+
+  /// Return the generators of the group
+  const std::vector<tensor_permutation_t> &generators() const {
+    return generators_;
+  }
+
+  /// Return the elements of the group (the first one is the identity)
+  const std::vector<tensor_permutation_t> &elements() const {
+    return elements_;
+  }
+
+  /// Return the number of elements of the group
+  int size() const { return elements_.size(); }
+
+  /// Return true if some elements exchange upper and lower indices
+  bool exchanges_upper_lower() const { return exchanges_upper_lower_; }
+
+  /// Bring the indices to the smallest arrangement (comparing first the lower
+  /// and then the upper indices) and return the sign. Returns zero if the
+  /// tensor vanishes because of its symmetry (e.g., v^{pp}_{rs} for an
+  /// antisymmetric tensor)
+  scalar_t canonicalize(std::vector<Index> &upper,
+                        std::vector<Index> &lower) const;
+
+  /// Rearrange the indices with an element of the group and return its sign.
+  /// Returns zero if the tensor vanishes because of its symmetry
+  scalar_t arrange(int element, std::vector<Index> &upper,
+                   std::vector<Index> &lower) const;
+
+  /// Return a string representation
+  std::string str() const;
+
+private:
+  /// Return true if an element with negative sign leaves the indices unchanged
+  bool vanishes(const std::vector<Index> &indices) const;
+
+  // ==> Class private data <==
+
+  int nupper_;
+  int nlower_;
+  std::vector<tensor_permutation_t> generators_;
+  std::vector<tensor_permutation_t> elements_;
+  bool exchanges_upper_lower_ = false;
+};
+
+/// Declare the permutation symmetry of the tensors with a given label and
+/// number of upper/lower indices. When a tensor is canonicalized, the declared
+/// symmetry takes the place of the one specified by its SymmetryType
+void add_tensor_symmetry(const std::string &label, int nupper, int nlower,
+                         const std::vector<tensor_permutation_t> &generators);
+
+/// Remove all the declared tensor symmetries
+void reset_tensor_symmetries();
+
+/// Return the symmetry group declared for a tensor or nullptr if there is none.
+/// The tensor is identified by the ID of its label (see Tensor::label_id). The
+/// group stays valid if the declared symmetries are changed
+std::shared_ptr<const TensorSymmetryGroup>
+find_tensor_symmetry(int label_id, int nupper, int nlower);
+
+/// Return a string representation of the declared tensor symmetries
+std::string tensor_symmetries_str();
+
+#endif // _wicked_tensor_symmetry_h_
@@ -24,7 +24,8 @@ scalar_t Term::coefficient() const { return coefficient_; }
 void Term::set(scalar_t c) { coefficient_ = c; }
 
 SymbolicTerm Term::symterm() const {
-  return SymbolicTerm(normal_ordered(), ops(), tensors());
+  // the copy shares the tensors and operators of this term
+  return SymbolicTerm(*this);
 }
 
 std::string Term::str() const {
@@ -9,4 +9,5 @@ using namespace pybind11::literals;
 /// Export the combinatorics
 void export_combinatorics(py::module &m) {
   m.def("integer_partitions", &integer_partitions);
+  m.def("bounded_compositions", &bounded_compositions, "n"_a, "caps"_a);
 }
\ No newline at end of file
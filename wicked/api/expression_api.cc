@@ -20,6 +20,7 @@ void export_Expression(py::module &m) {
       .def("__repr__", &Expression::str)
       .def("__str__", &Expression::str)
       .def("__len__", &Expression::size)
+      .def("__contains__", &Expression::contains)
       .def("__eq__", &Expression::operator==)
       .def("__add__",
            [](Expression lhs, const Expression &rhs) {
@@ -27,7 +28,7 @@ void export_Expression(py::module &m) {
              return lhs;
            })
       .def("__iter__",
-           [](Expression &e) {
+           [](const Expression &e) {
              return py::make_iterator(e.begin(), e.end());
            },
            py::keep_alive<0, 1>())
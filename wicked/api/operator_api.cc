@@ -15,7 +15,10 @@ using namespace pybind11::literals;
 void export_Operator(py::module &m) {
   py::class_<Operator, std::shared_ptr<Operator>>(m, "Operator")
       .def(py::init<const std::string &, const std::vector<int> &,
-                    const std::vector<int> &>())
+                    const std::vector<int> &, int>(),
+           "label"_a, "cre"_a, "ann"_a, "order"_a = 0)
+      .def("label", &Operator::label)
+      .def("order", &Operator::order)
       .def("__repr__", &Operator::str)
       .def("__str__", &Operator::str);
   m.def("diag_operator", &make_diag_operator, "Create a Operator object");
@@ -52,16 +55,32 @@ void export_OperatorExpression(py::module &m) {
            [](const OperatorExpression &lhs, const OperatorExpression &rhs) {
              return lhs * rhs;
            })
-      .def("canonicalize", &OperatorExpression::canonicalize);
+      .def("canonicalize", &OperatorExpression::canonicalize)
+      .def("prune", &OperatorExpression::prune, "minrank"_a, "maxrank"_a,
+           "Remove the products that cannot give terms with rank in the range "
+           "[minrank, maxrank] when contracted")
+      .def("truncate", &OperatorExpression::truncate, "maxorder"_a,
+           "Remove the products with perturbation order greater than "
+           "maxorder");
   m.def("op", &make_diag_operator_expression, "label"_a, "components"_a,
-        "unique"_a = false,
+        "unique"_a = false, "order"_a = 0,
         py::call_guard<py::scoped_ostream_redirect,
                        py::scoped_estream_redirect>(),
         "Create a OperatorExpression object");
 
   m.def(
       "commutator",
-      [](py::args args) {
+      [](py::args args, py::kwargs kwargs) {
+        int maxorder = std::numeric_limits<int>::max();
+        for (auto item : kwargs) {
+          const auto name = py::cast<std::string>(item.first);
+          if (name != "maxorder") {
+            throw py::type_error(
+                "commutator() got an unexpected keyword argument '" + name +
+                "'");
+          }
+          maxorder = py::cast<int>(item.second);
+        }
         int k = 0;
         OperatorExpression result;
         for (const auto &arg : args) {
@@ -69,15 +88,23 @@ void export_OperatorExpression(py::module &m) {
           if (k == 0) {
             result = object;
           } else {
-            result = commutator(result, object);
+            result = commutator(result, object, maxorder);
           }
           k += 1;
         }
         return result;
       },
-      "Create the commutator of a list of OperatorExpression objects");
+      "Create the commutator of a list of OperatorExpression objects. The "
+      "products with perturbation order greater than maxorder (optional "
+      "keyword argument) are skipped");
+
+  m.def("product", &product, "A"_a, "B"_a, "maxorder"_a,
+        "Create the product A B keeping only the products with perturbation "
+        "order less than or equal to maxorder");
 
-  m.def("bch_series", &bch_series,
+  m.def("bch_series", &bch_series, "A"_a, "B"_a, "n"_a, "minrank"_a = 0,
+        "maxrank"_a = std::numeric_limits<int>::max(),
+        "maxorder"_a = std::numeric_limits<int>::max(),
         "Creates the Baker-Campbell-Hausdorff "
         "expansion of exp(-B) A exp(B) truncated at "
         "a given order n");
@@ -16,6 +16,7 @@ void export_rational(py::module &m) {
       .def("latex", &rational::latex)
       .def("compile", &rational::compile)
       .def("__float__", &rational::to_double)
+      .def("is_floating_point", &rational::is_floating_point)
       .def("__eq__",
            [](const rational &lhs, const rational &rhs) { return lhs == rhs; })
       .def("__add__",
@@ -39,4 +40,10 @@ void export_rational(py::module &m) {
   m.def("make_rational", &make_rational_from_str);
   m.def("use_boost_1024_int", &use_boost_1024_int,
         "Return true if 1024-bit integers are used");
+  m.def("set_floating_point_coefficients", &set_floating_point_coefficients,
+        "val"_a,
+        "Enable/disable floating-point coefficients (not while a contraction "
+        "is running)");
+  m.def("floating_point_coefficients", &floating_point_coefficients,
+        "Return true if floating-point coefficients are enabled");
 }
\ No newline at end of file
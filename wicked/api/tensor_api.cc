@@ -2,6 +2,7 @@
 #include <pybind11/stl.h>
 
 #include "../wicked/algebra/tensor.h"
+#include "../wicked/algebra/tensor_symmetry.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
@@ -19,12 +20,23 @@ void export_Tensor(py::module &m) {
       .def("__repr__", &Tensor::str)
       .def("__str__", &Tensor::str)
       .def("label", &Tensor::label)
-      .def("lower", &Tensor::lower)
-      .def("upper", &Tensor::upper)
+      .def("lower",
+           [](const Tensor &t) { return std::vector<Index>(t.lower()); })
+      .def("upper",
+           [](const Tensor &t) { return std::vector<Index>(t.upper()); })
       .def("symmetry", &Tensor::symmetry)
       .def("latex", &Tensor::latex)
-      .def("compile", &Tensor::compile);
+      .def("compile", &Tensor::compile)
+      .def("canonicalize", &Tensor::canonicalize);
 
   m.def("tensor", &make_tensor, "label"_a, "lower"_a, "upper"_a, "symmetry"_a);
   m.def("tensor", &make_tensor_from_str, "s"_a, "symmetry"_a);
+
+  m.def("add_tensor_symmetry", &add_tensor_symmetry, "label"_a, "nupper"_a,
+        "nlower"_a, "generators"_a,
+        "Declare the permutation symmetry of a tensor. The generators are "
+        "pairs (permutation, sign), where the permutation acts on the upper "
+        "indices followed by the lower indices");
+  m.def("reset_tensor_symmetries", &reset_tensor_symmetries);
+  m.def("tensor_symmetries", &tensor_symmetries_str);
 }
\ No newline at end of file
@@ -36,4 +36,11 @@ void export_SymbolicTerm(py::module &m) {
       .def("add", py::overload_cast<const Tensor &>(&Term::add))
       .def("set", py::overload_cast<scalar_t>(&Term::set))
       .def("set_normal_ordered", &Term::set_normal_ordered);
+
+  m.def("set_term_interning", &set_term_interning, "val"_a,
+        "Store the tensors and operators of the terms added to expressions "
+        "only once");
+  m.def("term_interning", &term_interning);
+  m.def("clear_interned_terms", &clear_interned_terms);
+  m.def("num_interned_terms", &num_interned_terms);
 }
\ No newline at end of file
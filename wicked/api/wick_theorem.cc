@@ -32,8 +32,41 @@ void export_WickTheorem(py::module &m) {
             return wt.contract(scalar_t(1), expr, minrank, maxrank);
           },
           "expr"_a, "minrank"_a, "maxrank"_a)
+      .def("contract_commutator", &WickTheorem::contract_commutator)
+      .def(
+          "contract_commutator",
+          [](WickTheorem &wt, const OperatorExpression &A,
+             const OperatorExpression &B, const int minrank,
+             const int maxrank) {
+            return wt.contract_commutator(scalar_t(1), A, B, minrank, maxrank);
+          },
+          "A"_a, "B"_a, "minrank"_a, "maxrank"_a)
+      .def(
+          "count",
+          [](WickTheorem &wt, const OperatorExpression &expr, const int minrank,
+             const int maxrank) {
+            std::vector<std::pair<std::vector<Operator>, std::map<int, long>>>
+                result;
+            for (const auto &[ops, counts] :
+                 wt.count(expr, minrank, maxrank)) {
+              result.push_back(std::make_pair(ops.elements(), counts));
+            }
+            return result;
+          },
+          "expr"_a, "minrank"_a, "maxrank"_a,
+          "Count the contractions of each product of an operator expression. "
+          "Returns a list of pairs (product, {rank: number of contractions})")
       .def("set_print", &WickTheorem::set_print)
       .def("set_max_cumulant", &WickTheorem::set_max_cumulant)
+      .def("set_connected_only", &WickTheorem::set_connected_only)
+      .def("set_num_threads", &WickTheorem::set_num_threads)
+      .def("num_threads", &WickTheorem::num_threads)
       .def("do_canonicalize_graph", &WickTheorem::do_canonicalize_graph)
+      .def("set_use_contraction_cache",
+           &WickTheorem::set_use_contraction_cache)
+      .def("set_contraction_cache_max_size",
+           &WickTheorem::set_contraction_cache_max_size, "n"_a)
+      .def("clear_contraction_cache", &WickTheorem::clear_contraction_cache)
+      .def("set_disk_cache", &WickTheorem::set_disk_cache, "path"_a)
       .def("timers", &WickTheorem::timers);
 }
\ No newline at end of file
@@ -0,0 +1,208 @@
+#ifndef _wicked_contraction_cache_h_
+#define _wicked_contraction_cache_h_
+
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../algebra/symbolic_term.h"
+#include "contraction.h"
+#include "graph_matrix.h"
+
+/// The result of evaluating a canonical contraction graph
+struct CachedContraction {
+  /// The canonical term generated by the contraction
+  SymbolicTerm term;
+  /// The coefficient of the term (for a unit factor and sign)
+  scalar_t factor;
+};
+
+/// The canonical form of a contraction graph
+struct CachedCanonicalGraph {
+  /// The permutations that bring the operators and the contractions to the
+  /// canonical order (see WickTheorem::canonicalize_contraction_graph)
+  std::vector<int> ops_perm;
+  std::vector<int> contr_perm;
+  /// The sign of the permutation of the operators
+  scalar_t sign;
+  /// The signature of the canonical graph
+  std::string key;
+};
+
+/// A map from strings to values that holds at most max_size() elements. When
+/// it is full, the element stored first is removed. It is not thread safe
+template <class V> class FifoMap {
+public:
+  /// Find an element. Returns nullptr if the key is not found
+  const V *find(const std::string &key) const {
+    auto it = map_.find(key);
+    return (it == map_.end()) ? nullptr : &it->second;
+  }
+
+  /// Add an element. If the map is full the element stored first is removed
+  void insert(const std::string &key, const V &value) {
+    if (max_size_ == 0)
+      return;
+    auto [it, inserted] = map_.emplace(key, value);
+    if (not inserted)
+      return;
+    if (order_.size() < max_size_) {
+      order_.push_back(&it->first);
+      return;
+    }
+    map_.erase(map_.find(*order_[oldest_]));
+    order_[oldest_] = &it->first;
+    oldest_ = (oldest_ + 1) % max_size_;
+  }
+
+  /// Set the largest number of elements stored. The map is emptied
+  void set_max_size(size_t n) {
+    max_size_ = n;
+    clear();
+  }
+
+  /// Return the largest number of elements stored
+  size_t max_size() const { return max_size_; }
+
+  /// Remove all the elements
+  void clear() {
+    map_.clear();
+    order_.clear();
+    oldest_ = 0;
+  }
+
+  /// The number of elements stored
+  size_t size() const { return map_.size(); }
+
+private:
+  std::unordered_map<std::string, V> map_;
+  /// The keys of the elements in the order in which they were stored (a
+  /// circular buffer that starts at position oldest_ once it is full). The
+  /// pointers stay valid when the map is rehashed
+  std::vector<const std::string *> order_;
+  size_t oldest_ = 0;
+  size_t max_size_ = 100000;
+};
+
+/// A cache of contractions. It has two levels: the first one maps the
+/// signature of a contraction graph to its canonical form, and the second one
+/// maps the signature of a canonical graph to the result of evaluating it. A
+/// contraction found in the first level is not canonicalized, and one found in
+/// the second level is not evaluated. It also stores the elementary
+/// contractions of products of operators, keyed by the graph matrices of the
+/// operators. Each of these maps holds at most max_size() elements: when it is
+/// full, the element stored first is removed.
+///
+/// The cache may be shared by several threads. Since the keys refer to the
+/// orbital spaces by their position, the cache is emptied when the orbital
+/// spaces (or the declared tensor symmetries) change.
+class ContractionCache {
+public:
+  /// Find the canonical form of a contraction graph. Returns true if it is in
+  /// the cache
+  bool find_graph(const std::string &key, CachedCanonicalGraph &value) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return copy_found(graph_map_.find(key), value);
+  }
+
+  /// Add the canonical form of a contraction graph to the cache
+  void insert_graph(const std::string &key, const CachedCanonicalGraph &value) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    graph_map_.insert(key, value);
+  }
+
+  /// Find a contraction. Returns true if it is in the cache
+  bool find(const std::string &key, CachedContraction &value) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return copy_found(map_.find(key), value);
+  }
+
+  /// Add a contraction to the cache
+  void insert(const std::string &key, const CachedContraction &value) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    map_.insert(key, value);
+  }
+
+  /// Set the largest number of elements stored in each level. The cache is
+  /// emptied
+  void set_max_size(size_t n) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    graph_map_.set_max_size(n);
+    map_.set_max_size(n);
+    elementary_map_.set_max_size(n);
+  }
+
+  /// Return the largest number of elements stored in each level
+  size_t max_size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return map_.max_size();
+  }
+
+  /// Find the elementary contractions of a product of operators. Returns true
+  /// if they are in the cache
+  bool find_elementary(const std::string &key,
+                       std::vector<ElementaryContraction> &value) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return copy_found(elementary_map_.find(key), value);
+  }
+
+  /// Add the elementary contractions of a product of operators to the cache
+  void insert_elementary(const std::string &key,
+                         const std::vector<ElementaryContraction> &value) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    elementary_map_.insert(key, value);
+  }
+
+  /// Empty the cache if the orbital spaces differ from the ones used to fill
+  /// it. The orbital spaces and tensor symmetries are passed as a string
+  void check_spaces(const std::string &spaces) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      if (spaces == spaces_)
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (spaces != spaces_) {
+      clear_all();
+      spaces_ = spaces;
+    }
+  }
+
+  /// Empty the cache
+  void clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    clear_all();
+  }
+
+  /// The number of contractions stored
+  size_t size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return map_.size();
+  }
+
+private:
+  /// Copy a value found in a map. Returns false if it was not found
+  template <class V> static bool copy_found(const V *found, V &value) {
+    if (found == nullptr)
+      return false;
+    value = *found;
+    return true;
+  }
+
+  /// Remove all the elements (the lock must be held by the caller)
+  void clear_all() {
+    graph_map_.clear();
+    map_.clear();
+    elementary_map_.clear();
+  }
+
+  mutable std::shared_mutex mutex_;
+  FifoMap<CachedCanonicalGraph> graph_map_;
+  FifoMap<CachedContraction> map_;
+  FifoMap<std::vector<ElementaryContraction>> elementary_map_;
+  std::string spaces_;
+};
+
+#endif // _wicked_contraction_cache_h_
@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cassert>
 #include <numeric>
+#include <stdexcept>
 
 #include "graph_matrix.h"
 #include "helpers/helpers.h"
@@ -12,66 +14,33 @@ GraphMatrix::GraphMatrix() {}
 GraphMatrix::GraphMatrix(const std::vector<int> &cre,
                          const std::vector<int> &ann) {
   for (int i = 0; i < orbital_subspaces->num_spaces(); i++) {
-    elements_[i] = std::make_pair(cre[i], ann[i]);
+    set_cre(i, cre[i]);
+    set_ann(i, ann[i]);
   }
 }
 
-const GraphMatrix::graph_matrix_t &GraphMatrix::elements() const {
-  return elements_;
+std::pair<int, int> GraphMatrix::elements(int space) const {
+  return std::make_pair(cre(space), ann(space));
 }
 
-const std::pair<int, int> &GraphMatrix::elements(int space) const {
-  return elements_[space];
-}
-
-int GraphMatrix::cre(int space) const { return elements_[space].first; }
-
-int GraphMatrix::ann(int space) const { return elements_[space].second; }
-
 void GraphMatrix::set_cre(int space, int value) {
-  elements_[space].first = value;
+  set_count(space, shift(space), value);
 }
 
 void GraphMatrix::set_ann(int space, int value) {
-  elements_[space].second = value;
-}
-
-int GraphMatrix::num_ops(int space) const { return cre(space) + ann(space); }
-
-int GraphMatrix::num_ops() const {
-  int r = 0;
-  for (const auto &pair : elements_) {
-    r += pair.first + pair.second;
-  }
-  return r;
-}
-
-bool GraphMatrix::operator<(GraphMatrix const &other) const {
-  return elements_ < other.elements_;
-}
-
-bool GraphMatrix::operator==(GraphMatrix const &other) const {
-  return elements_ == other.elements_;
+  set_count(space, shift(space) - 8, value);
 }
 
-bool GraphMatrix::operator!=(GraphMatrix const &other) const {
-  return elements_ != other.elements_;
-}
-
-GraphMatrix &GraphMatrix::operator+=(const GraphMatrix &rhs) {
-  for (int s = 0; s < orbital_subspaces->num_spaces(); ++s) {
-    elements_[s].first += rhs.elements_[s].first;
-    elements_[s].second += rhs.elements_[s].second;
-  }
-  return *this;
-}
-
-GraphMatrix &GraphMatrix::operator-=(const GraphMatrix &rhs) {
-  for (int s = 0; s < orbital_subspaces->num_spaces(); ++s) {
-    elements_[s].first -= rhs.elements_[s].first;
-    elements_[s].second -= rhs.elements_[s].second;
+void GraphMatrix::set_count(int space, int offset, int value) {
+  if ((value < 0) or (value > max_count)) {
+    throw std::runtime_error(
+        "GraphMatrix::set_count - the number of operators (" +
+        std::to_string(value) + ") must be in the range [0," +
+        std::to_string(max_count) + "]");
   }
-  return *this;
+  auto &w = elements_[word(space)];
+  w &= ~(std::uint64_t(0xff) << offset);
+  w |= std::uint64_t(value) << offset;
 }
 
 GraphMatrix GraphMatrix::adjoint() const {
@@ -134,6 +103,44 @@ std::string to_string(const std::vector<GraphMatrix> &elements_vec) {
   return join(lines, "\n");
 }
 
+int max_contracted_ops(const std::vector<GraphMatrix> &graph_matrix,
+                       int first_space) {
+  // Every elementary contraction removes the same number of creation and
+  // annihilation operators of one space from at least two graph matrices, and
+  // in occupied (unoccupied) spaces a creation (annihilation) operator can
+  // only be contracted with an operator to its right.
+  int nops = graph_matrix.size();
+  int max_contracted = 0;
+  for (int s = first_space; s < orbital_subspaces->num_spaces(); s++) {
+    int sumcre = 0;
+    int sumann = 0;
+    int nops_in_space = 0;
+    for (const auto &gm : graph_matrix) {
+      sumcre += gm.cre(s);
+      sumann += gm.ann(s);
+      nops_in_space += (gm.num_ops(s) > 0);
+    }
+    if (nops_in_space < 2)
+      continue;
+    int max_pairs = std::min(sumcre, sumann);
+    SpaceType space_type = orbital_subspaces->space_type(s);
+    if (space_type != SpaceType::General) {
+      bool occupied = (space_type == SpaceType::Occupied);
+      // count the operators that have a partner to their right
+      int pairs = 0;
+      int right = 0;
+      for (int A = nops - 1; A >= 0; A--) {
+        const auto &gm = graph_matrix[A];
+        pairs += std::min(occupied ? gm.cre(s) : gm.ann(s), right);
+        right += occupied ? gm.ann(s) : gm.cre(s);
+      }
+      max_pairs = std::min(max_pairs, pairs);
+    }
+    max_contracted += 2 * max_pairs;
+  }
+  return max_contracted;
+}
+
 std::string signature(const GraphMatrix &graph_matrix) {
   std::string str;
   for (int s = 0; s < orbital_subspaces->num_spaces(); ++s) {
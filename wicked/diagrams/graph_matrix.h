@@ -2,6 +2,7 @@
 #define _wicked_diag_elements_h_
 
 #include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -13,22 +14,26 @@
 class GraphMatrix {
   // Here we use an optimized way to store the graph matrix
   // We assume that we work at most with 8 different spaces, which
-  // should be enough for virtually any type of application
+  // should be enough for virtually any type of application.
+  // The number of creation and annihilation operators in each space is stored
+  // as an 8-bit count and all the counts are packed in a 128-bit word (two
+  // 64-bit integers). Addition, subtraction, and comparison of graph matrices
+  // operate on all counts at once.
   static constexpr int max_spaces_ = 8;
-  using graph_matrix_t = std::array<std::pair<int, int>, max_spaces_>;
+  using graph_matrix_t = std::array<std::uint64_t, 2>;
 
 public:
+  /// The largest number of creation (annihilation) operators in one space
+  static constexpr int max_count = 127;
+
   /// Constructor
   GraphMatrix();
 
   /// Constructor. Set number of creation and annihilation operators
   GraphMatrix(const std::vector<int> &cre, const std::vector<int> &ann);
 
-  /// Return a vector of pairs of creation/annihilation operators
-  const graph_matrix_t &elements() const;
-
   /// Return a pair of creation/annihilation operators in space
-  const std::pair<int, int> &elements(int space) const;
+  std::pair<int, int> elements(int space) const;
 
   /// Return the number of creation operators in space
   int cre(int space) const;
@@ -50,11 +55,18 @@ public:
   /// graph matrix in a given space
   int num_ops(int space) const;
 
+  /// Return true if all the operator counts of this object are greater than or
+  /// equal to those of other (other can be subtracted from this object)
+  bool contains(const GraphMatrix &other) const;
+
   /// Comparison operators used for sorting
   bool operator<(GraphMatrix const &other) const;
   bool operator==(GraphMatrix const &other) const;
   bool operator!=(GraphMatrix const &other) const;
 
+  /// Return a hash value (equal objects have equal hashes)
+  std::uint64_t hash() const;
+
   // Adds the operator count of another object
   GraphMatrix &operator+=(const GraphMatrix &rhs);
 
@@ -72,16 +84,99 @@ public:
 
 private:
   /// This object stores the number of creation/annihilation
-  /// operators in each space. This initializes it to all zeros
+  /// operators in each space. This initializes it to all zeros.
+  /// The counts are stored from the most significant byte of the first word
+  /// in the order cre(0), ann(0), cre(1), ann(1), ..., so that comparing the
+  /// words is equivalent to comparing the counts in lexicographical order
   graph_matrix_t elements_ = {};
+
+  /// Return the word and the bit shift of the creation operator count of a
+  /// space (the annihilation operator count follows after 8 bits)
+  static int word(int space) { return space / 4; }
+  static int shift(int space) { return 56 - 16 * (space % 4); }
+
+  /// Set the operator count stored at a given bit shift
+  void set_count(int space, int offset, int value);
 };
 
+// Inline functions used in the innermost loops of the Wick theorem
+
+inline int GraphMatrix::cre(int space) const {
+  return (elements_[word(space)] >> shift(space)) & 0xff;
+}
+
+inline int GraphMatrix::ann(int space) const {
+  return (elements_[word(space)] >> (shift(space) - 8)) & 0xff;
+}
+
+inline int GraphMatrix::num_ops(int space) const {
+  return cre(space) + ann(space);
+}
+
+inline int GraphMatrix::num_ops() const {
+  // add pairs of 8-bit counts into 16-bit counts and then add those
+  constexpr std::uint64_t low_bytes = 0x00ff00ff00ff00ffULL;
+  int r = 0;
+  for (std::uint64_t w : elements_) {
+    std::uint64_t pairs = (w & low_bytes) + ((w >> 8) & low_bytes);
+    r += (pairs * 0x0001000100010001ULL) >> 48;
+  }
+  return r;
+}
+
+inline bool GraphMatrix::contains(const GraphMatrix &other) const {
+  // Since counts are at most 127, subtracting other from this object after
+  // setting the high bit of each count leaves the high bit set only where
+  // this count is greater than or equal to the one of other
+  constexpr std::uint64_t high_bits = 0x8080808080808080ULL;
+  return ((((elements_[0] | high_bits) - other.elements_[0]) &
+           ((elements_[1] | high_bits) - other.elements_[1])) &
+          high_bits) == high_bits;
+}
+
+inline bool GraphMatrix::operator<(GraphMatrix const &other) const {
+  return elements_ < other.elements_;
+}
+
+inline bool GraphMatrix::operator==(GraphMatrix const &other) const {
+  return elements_ == other.elements_;
+}
+
+inline bool GraphMatrix::operator!=(GraphMatrix const &other) const {
+  return elements_ != other.elements_;
+}
+
+inline std::uint64_t GraphMatrix::hash() const {
+  // multiply the first word by an odd constant so that its bits spread
+  return (elements_[0] * 0x9e3779b97f4a7c15ULL) ^ elements_[1];
+}
+
+inline GraphMatrix &GraphMatrix::operator+=(const GraphMatrix &rhs) {
+  // counts never exceed 8 bits, so there is no carry between them
+  elements_[0] += rhs.elements_[0];
+  elements_[1] += rhs.elements_[1];
+  return *this;
+}
+
+inline GraphMatrix &GraphMatrix::operator-=(const GraphMatrix &rhs) {
+  // rhs is always contained in this object, so there is no borrow
+  elements_[0] -= rhs.elements_[0];
+  elements_[1] -= rhs.elements_[1];
+  return *this;
+}
+
 // Helper functions
 
 /// Return the sum of the number creation and annihilation operator for a vector
 /// of graph matrices
 int sum_num_ops(const std::vector<GraphMatrix> &graph_matrix);
 
+/// Return an upper bound to the number of operators of a vector of graph
+/// matrices that can be removed by contracting them in the spaces starting
+/// from first_space
+int max_contracted_ops(const std::vector<GraphMatrix> &graph_matrix,
+                       int first_space = 0);
+
 /// Return a nice string representation of a vector of graph matrices
 std::string to_string(const std::vector<GraphMatrix> &elements_vec);
 
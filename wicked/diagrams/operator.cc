@@ -7,14 +7,22 @@
 using namespace std;
 
 Operator::Operator(const std::string &label, const std::vector<int> &cre,
-                   const std::vector<int> &ann)
-    : label_(label), graph_matrix_(cre, ann) {}
-
-Operator::Operator(const std::string &label, const GraphMatrix &graph_matrix)
-    : label_(label), graph_matrix_(graph_matrix) {}
+                   const std::vector<int> &ann, int order)
+    : Operator(label, GraphMatrix(cre, ann), order) {}
+
+Operator::Operator(const std::string &label, const GraphMatrix &graph_matrix,
+                   int order)
+    : label_(label), graph_matrix_(graph_matrix), order_(order) {
+  if (order < 0) {
+    throw std::runtime_error(
+        "Operator::Operator - the perturbation order must be non-negative");
+  }
+}
 
 const std::string &Operator::label() const { return label_; }
 
+int Operator::order() const { return order_; }
+
 GraphMatrix Operator::graph_matrix() const { return graph_matrix_; }
 
 scalar_t Operator::factor() const {
@@ -29,7 +37,7 @@ scalar_t Operator::factor() const {
 }
 
 Operator Operator::adjoint() const {
-  return Operator(label(), graph_matrix().adjoint());
+  return Operator(label(), graph_matrix().adjoint(), order_);
 }
 
 int Operator::cre(int space) const { return graph_matrix_.cre(space); }
@@ -45,15 +53,27 @@ bool Operator::operator<(Operator const &other) const {
   if (label_ > other.label_)
     return false;
   // Compare the graph matrices
-  return graph_matrix_ < other.graph_matrix_;
+  if (graph_matrix_ < other.graph_matrix_)
+    return true;
+  if (other.graph_matrix_ < graph_matrix_)
+    return false;
+  // Compare the orders
+  return order_ < other.order_;
 }
 
 bool Operator::operator==(Operator const &other) const {
-  return ((label_ == other.label_) and (graph_matrix_ == other.graph_matrix_));
+  return ((label_ == other.label_) and
+          (graph_matrix_ == other.graph_matrix_) and (order_ == other.order_));
+}
+
+std::uint64_t Operator::hash() const {
+  return hash_combine(
+      hash_combine(std::hash<std::string>()(label_), graph_matrix_.hash()),
+      order_);
 }
 
 bool Operator::operator!=(Operator const &other) const {
-  return ((label_ != other.label_) or (graph_matrix_ != other.graph_matrix_));
+  return not(*this == other);
 }
 
 std::string Operator::str() const {
@@ -15,14 +15,19 @@ public:
   /// @param label: the label of the operator
   /// @param cre: the number of creation operators per orbital space
   /// @param ann: the number of annihilation operators per orbital space
+  /// @param order: the perturbation order of the operator
   Operator(const std::string &label, const std::vector<int> &cre,
-           const std::vector<int> &ann);
+           const std::vector<int> &ann, int order = 0);
 
-  Operator(const std::string &label, const GraphMatrix &graph_matrix);
+  Operator(const std::string &label, const GraphMatrix &graph_matrix,
+           int order = 0);
 
   /// Return the label of the operator
   const std::string &label() const;
 
+  /// Return the perturbation order of the operator
+  int order() const;
+
   /// The graph matrix object
   GraphMatrix graph_matrix() const;
 
@@ -47,6 +52,9 @@ public:
   bool operator==(Operator const &other) const;
   bool operator!=(Operator const &other) const;
 
+  /// Return a hash value (equal operators have equal hashes)
+  std::uint64_t hash() const;
+
   /// Return a string representation of the operator
   std::string str() const;
 
@@ -59,6 +67,9 @@ private:
 
   /// The number of creation/annihilation operators in each space
   GraphMatrix graph_matrix_;
+
+  /// The perturbation order
+  int order_ = 0;
 };
 
 /// Check if two operators commute
@@ -15,14 +15,14 @@ OperatorExpression::OperatorExpression(
 }
 
 void OperatorExpression::add2(const OperatorExpression &expr, scalar_t factor) {
-  for (const auto &vec_dop_factor : expr.terms()) {
+  for (const auto &vec_dop_factor : expr.terms().unsorted()) {
     add(vec_dop_factor.first, factor * vec_dop_factor.second);
   }
 }
 
 void OperatorExpression::canonicalize() {
   opexpr_t canonical;
-  for (auto [prod, scalar] : terms_) {
+  for (auto [prod, scalar] : terms_.unsorted()) {
     auto newprod = prod;
     const auto sign = newprod.canonicalize();
     add_to_map(canonical, newprod, sign * scalar);
@@ -30,6 +30,26 @@ void OperatorExpression::canonicalize() {
   terms_ = canonical;
 }
 
+void OperatorExpression::prune(int minrank, int maxrank) {
+  opexpr_t pruned;
+  for (const auto &[prod, scalar] : terms_.unsorted()) {
+    if (prod.can_contribute(minrank, maxrank)) {
+      pruned.add(prod, scalar);
+    }
+  }
+  terms_ = pruned;
+}
+
+void OperatorExpression::truncate(int maxorder) {
+  opexpr_t truncated;
+  for (const auto &[prod, scalar] : terms_.unsorted()) {
+    if (prod.order() <= maxorder) {
+      truncated.add(prod, scalar);
+    }
+  }
+  terms_ = truncated;
+}
+
 std::string OperatorExpression::str() const {
   std::vector<std::string> str_vec;
   for (auto &vec_dop_factor : terms_) {
@@ -49,6 +69,24 @@ OperatorExpression operator*(OperatorExpression lhs,
   return lhs;
 }
 
+OperatorExpression product(const OperatorExpression &A,
+                           const OperatorExpression &B, int maxorder) {
+  OperatorExpression result;
+  for (const auto &[prod_a, c_a] : A.terms().unsorted()) {
+    const int order_a = prod_a.order();
+    if (order_a > maxorder)
+      continue;
+    for (const auto &[prod_b, c_b] : B.terms().unsorted()) {
+      // the orders are non-negative, so the product can be skipped before it
+      // is formed
+      if (order_a + prod_b.order() > maxorder)
+        continue;
+      result.add(prod_a * prod_b, c_a * c_b);
+    }
+  }
+  return result;
+}
+
 OperatorExpression operator+(OperatorExpression lhs,
                              const OperatorExpression &rhs) {
   lhs += rhs;
@@ -69,7 +107,7 @@ std::ostream &operator<<(std::ostream &os, const OperatorExpression &opsum) {
 OperatorExpression
 make_diag_operator_expression(const std::string &label,
                               const std::vector<std::string> &components,
-                              bool unique) {
+                              bool unique, int order) {
   OperatorExpression result;
 
   for (const std::string &s : components) {
@@ -85,7 +123,7 @@ make_diag_operator_expression(const std::string &label,
         ann[space] += 1;
       }
     }
-    Operator op(label, cre, ann);
+    Operator op(label, cre, ann, order);
     // if we want unique terms, we check if the term is already in the result
     if (unique and result.contains({op})) {
       continue;
@@ -96,22 +134,31 @@ make_diag_operator_expression(const std::string &label,
 }
 
 OperatorExpression commutator(const OperatorExpression &A,
-                              const OperatorExpression &B) {
-  return A * B - B * A;
+                              const OperatorExpression &B, int maxorder) {
+  return product(A, B, maxorder) - product(B, A, maxorder);
 }
 
 OperatorExpression bch_series(const OperatorExpression &A,
-                              const OperatorExpression &B, int n) {
+                              const OperatorExpression &B, int n, int minrank,
+                              int maxrank, int maxorder) {
   OperatorExpression result;
   result += A;
-  OperatorExpression temp(A);
+  result.truncate(maxorder);
+  OperatorExpression temp(result);
 
   for (int k = 1; k <= n; k++) {
-    OperatorExpression comm = commutator(temp, B);
+    // the orders are non-negative, so the nested commutators can be truncated
+    // at each step
+    OperatorExpression comm = commutator(temp, B, maxorder);
     comm *= scalar_t(1, k);
     result += comm;
     temp = comm;
   }
 
+  // the nested commutators are multiplied by B at the next order, so the
+  // products are pruned only at the end
+  if ((minrank > 0) or (maxrank < std::numeric_limits<int>::max())) {
+    result.prune(minrank, maxrank);
+  }
   return result;
 }
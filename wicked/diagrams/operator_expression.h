@@ -1,6 +1,7 @@
 #ifndef _wicked_diag_operator_set_h_
 #define _wicked_diag_operator_set_h_
 
+#include <limits>
 #include <map>
 #include <vector>
 
@@ -24,6 +25,15 @@ public:
 
   void canonicalize();
 
+  /// Remove the products that cannot give terms with rank (number of
+  /// uncontracted second quantized operators) in the range [minrank, maxrank]
+  /// when they are contracted
+  void prune(int minrank, int maxrank);
+
+  /// Remove the products of operators with perturbation order greater than
+  /// maxorder
+  void truncate(int maxorder);
+
   OperatorExpression adjoint() const {
     OperatorExpression expr;
     for (const auto &[e, c] : terms_) {
@@ -43,6 +53,11 @@ public:
 OperatorExpression operator*(OperatorExpression lhs,
                              const OperatorExpression &rhs);
 
+/// Creates a new object with the product A B keeping only the products of
+/// operators with perturbation order less than or equal to maxorder
+OperatorExpression product(const OperatorExpression &A,
+                           const OperatorExpression &B, int maxorder);
+
 /// addition
 OperatorExpression operator+(OperatorExpression lhs,
                              const OperatorExpression &rhs);
@@ -60,21 +75,29 @@ std::ostream &operator<<(std::ostream &os, const OperatorExpression &opsum);
 /// @param components a vector of strings of the form "v+ v+ o o" which specify
 /// the components of this operator E.g. auto T1 = make_operator("T1", {"v+
 /// o"}); auto F = make_operator("F", {"o+ o","v+ o","o+ v","v+ v"});
+/// @param order the perturbation order of the operator
 OperatorExpression
 make_diag_operator_expression(const std::string &label,
                               const std::vector<std::string> &components,
-                              bool unique = false);
+                              bool unique = false, int order = 0);
 
-/// Creates a new object with the commutator [A,B]
-OperatorExpression commutator(const OperatorExpression &A,
-                              const OperatorExpression &B);
+/// Creates a new object with the commutator [A,B] keeping only the products of
+/// operators with perturbation order less than or equal to maxorder
+OperatorExpression
+commutator(const OperatorExpression &A, const OperatorExpression &B,
+           int maxorder = std::numeric_limits<int>::max());
 
 // /// Creates a new object with the exponential exp(A) truncated at a given
 // order OperatorExpression exp(const OperatorExpression &A, int order);
 
 /// Creates a new object with the Baker-Campbell-Hausdorff expansion of the
-/// quantity exp(-B) A exp(B) truncated at a given order n
-OperatorExpression bch_series(const OperatorExpression &A,
-                              const OperatorExpression &B, int n);
+/// quantity exp(-B) A exp(B) truncated at a given order n. Only the products
+/// that can give terms with rank in the range [minrank, maxrank] when they are
+/// contracted and with perturbation order less than or equal to maxorder are
+/// kept
+OperatorExpression
+bch_series(const OperatorExpression &A, const OperatorExpression &B, int n,
+           int minrank = 0, int maxrank = std::numeric_limits<int>::max(),
+           int maxorder = std::numeric_limits<int>::max());
 
 #endif // _wicked_diag_operator_set_h_
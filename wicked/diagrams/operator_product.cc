@@ -1,3 +1,8 @@
+#include <algorithm>
+
+#include "helpers/helpers.h"
+#include "helpers/orbital_space.h"
+
 #include "operator_product.h"
 #include "operator.h"
 
@@ -11,6 +16,41 @@ int OperatorProduct::num_ops() const {
   return r;
 }
 
+int OperatorProduct::order() const {
+  int r = 0;
+  for (const auto &op : elements_) {
+    r += op.order();
+  }
+  return r;
+}
+
+int OperatorProduct::min_rank() const {
+  std::vector<GraphMatrix> graph_matrix_vec;
+  for (const auto &op : elements_) {
+    graph_matrix_vec.push_back(op.graph_matrix());
+  }
+  return num_ops() - max_contracted_ops(graph_matrix_vec);
+}
+
+bool OperatorProduct::can_contribute(int minrank, int maxrank) const {
+  // contractions remove an even number of operators, so all the terms have
+  // the same parity as the number of operators
+  const int n = num_ops();
+  int lowest = std::max(minrank, min_rank());
+  if ((lowest - n) % 2 != 0) {
+    lowest += 1;
+  }
+  return lowest <= std::min(maxrank, n);
+}
+
+std::uint64_t OperatorProduct::hash() const {
+  std::uint64_t h = elements_.size();
+  for (const auto &op : elements_) {
+    h = hash_combine(h, op.hash());
+  }
+  return h;
+}
+
 scalar_t OperatorProduct::canonicalize() {
   int nperm = 0;
   int n = elements_.size();
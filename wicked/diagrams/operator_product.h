@@ -1,6 +1,8 @@
 #ifndef _wicked_operator_product_h_
 #define _wicked_operator_product_h_
 
+#include <cstdint>
+
 #include "helpers/product.hpp"
 #include "wicked-def.h"
 
@@ -19,6 +21,24 @@ public:
   scalar_t canonicalize();
 
   int num_ops() const;
+
+  /// Return the perturbation order (the sum of the orders of the operators)
+  int order() const;
+
+  /// Return a lower bound to the rank (number of uncontracted second quantized
+  /// operators) of the terms obtained by contracting this product. The bound
+  /// takes into account the number of operators that can be contracted in
+  /// each space and, for occupied (unoccupied) spaces, that a creation
+  /// (annihilation) operator can only be contracted with an operator to its
+  /// right
+  int min_rank() const;
+
+  /// Return false if contracting this product cannot give terms with rank in
+  /// the range [minrank, maxrank]
+  bool can_contribute(int minrank, int maxrank) const;
+
+  /// Return a hash value (equal products have equal hashes)
+  std::uint64_t hash() const;
 };
 
 OperatorProduct operator*(const OperatorProduct &l, const OperatorProduct &r);
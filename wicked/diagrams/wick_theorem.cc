@@ -1,10 +1,16 @@
 #include <iostream>
+#include <map>
 
 #include "contraction.h"
+#include "contraction_cache.h"
+#include "helpers/orbital_space.h"
+#include "helpers/parallel.hpp"
 #include "helpers/timer.hpp"
 #include "operator.h"
 #include "operator_expression.h"
 
+#include "../algebra/tensor_symmetry.h"
+
 #include "wick_theorem.h"
 
 #define PRINT(detail, code)                                                    \
@@ -14,55 +20,253 @@
 
 using namespace std;
 
-WickTheorem::WickTheorem() {}
+WickTheorem::WickTheorem()
+    : contraction_cache_(std::make_shared<ContractionCache>()),
+      disk_cache_warned_(std::make_shared<std::atomic<bool>>(false)) {}
 
 void WickTheorem::set_print(PrintLevel print) { print_ = print; }
 
 void WickTheorem::set_max_cumulant(int n) { maxcumulant_ = n; }
 
+void WickTheorem::set_connected_only(bool val) { connected_only_ = val; }
+
+void WickTheorem::set_num_threads(int n) {
+  if (n < 1) {
+    throw std::runtime_error(
+        "WickTheorem::set_num_threads - the number of threads must be >= 1");
+  }
+  num_threads_ = n;
+}
+
+int WickTheorem::num_threads() const { return num_threads_; }
+
 void WickTheorem::do_canonicalize_graph(bool val) {
   do_canonicalize_graph_ = val;
 }
 
+void WickTheorem::set_use_contraction_cache(bool val) {
+  use_contraction_cache_ = val;
+}
+
+void WickTheorem::set_contraction_cache_max_size(int n) {
+  if (n < 0) {
+    throw std::runtime_error("WickTheorem::set_contraction_cache_max_size - "
+                             "the size must be >= 0");
+  }
+  contraction_cache_->set_max_size(n);
+}
+
+void WickTheorem::clear_contraction_cache() { contraction_cache_->clear(); }
+
+void WickTheorem::set_disk_cache(const std::string &path) {
+  disk_cache_path_ = path;
+}
+
 const std::map<std::string, double> &WickTheorem::timers() const {
   return timers_;
 }
 
 Expression WickTheorem::contract(scalar_t factor, const OperatorProduct &ops,
                                  const int minrank, const int maxrank) {
+  check_contraction_cache();
+  return contract_product(factor, ops, minrank, maxrank, 0);
+}
+
+Expression WickTheorem::contract(scalar_t factor,
+                                 const OperatorExpression &expr,
+                                 const int minrank, const int maxrank) {
+  std::vector<std::tuple<OperatorProduct, scalar_t, std::uint64_t>> products;
+  for (const auto &[ops, f] : expr.terms()) {
+    products.push_back(std::make_tuple(ops, f, 0));
+  }
+  return contract_products(factor, products, minrank, maxrank);
+}
+
+Expression WickTheorem::contract_commutator(scalar_t factor,
+                                            const OperatorExpression &A,
+                                            const OperatorExpression &B,
+                                            const int minrank,
+                                            const int maxrank) {
+  // bit mask of the first n operators of a product
+  auto first_ops = [](int n) {
+    if (n > 64) {
+      throw std::runtime_error(
+          "WickTheorem::contract_commutator - the commutator is supported only "
+          "for operators with up to 64 factors");
+    }
+    return (n == 64) ? ~std::uint64_t(0) : (std::uint64_t(1) << n) - 1;
+  };
+
+  // Expand [A, B] = sum_ab [a, b] = sum_ab (ab - ba). When the terms of ab in
+  // which a is not contracted with b are not linked they cancel with the
+  // corresponding terms of ba, unless both a and b are odd
+  std::map<std::pair<OperatorProduct, std::uint64_t>, scalar_t> terms;
+  for (const auto &[a, fa] : A.terms()) {
+    for (const auto &[b, fb] : B.terms()) {
+      bool linked = (a.num_ops() % 2 == 0) or (b.num_ops() % 2 == 0);
+      OperatorProduct ab(a * b);
+      OperatorProduct ba(b * a);
+      terms[std::make_pair(ab, linked ? first_ops(a.size()) : 0)] += fa * fb;
+      terms[std::make_pair(ba, linked ? first_ops(b.size()) : 0)] -= fa * fb;
+    }
+  }
+
+  std::vector<std::tuple<OperatorProduct, scalar_t, std::uint64_t>> products;
+  for (const auto &[key, f] : terms) {
+    if (f != scalar_t(0)) {
+      products.push_back(std::make_tuple(key.first, f, key.second));
+    }
+  }
+  return contract_products(factor, products, minrank, maxrank);
+}
+
+std::map<int, long> WickTheorem::count(const OperatorProduct &ops,
+                                       const int minrank, const int maxrank) {
+  check_contraction_cache();
+  return count_product(ops, minrank, maxrank);
+}
+
+std::vector<std::pair<OperatorProduct, std::map<int, long>>>
+WickTheorem::count(const OperatorExpression &expr, const int minrank,
+                   const int maxrank) {
+  check_contraction_cache();
+  std::vector<std::pair<OperatorProduct, std::map<int, long>>> result;
+  for (const auto &[ops, f] : expr.terms()) {
+    result.push_back(std::make_pair(ops, count_product(ops, minrank, maxrank)));
+  }
+  return result;
+}
+
+std::map<int, long> WickTheorem::count_product(const OperatorProduct &ops,
+                                               const int minrank,
+                                               const int maxrank) {
+  timer t;
+  elementary_contractions_ = generate_elementary_contractions(ops);
+  std::map<int, long> result =
+      count_composite_contractions(ops, minrank, maxrank);
+  timers_["count"] += t.get();
+  return result;
+}
+
+Expression WickTheorem::contract_product(scalar_t factor,
+                                         const OperatorProduct &ops,
+                                         const int minrank, const int maxrank,
+                                         std::uint64_t linked_ops) {
   ncontractions_ = 0;
-  contractions_.clear();
   elementary_contractions_.clear();
 
+  // skip the products that cannot give terms in the range of ranks requested
+  if (not ops.can_contribute(minrank, maxrank)) {
+    timers_["pruned products"] += 1;
+    return Expression();
+  }
+
   PRINT(
       PrintLevel::Summary, std::cout << "\nContracting the operators: ";
       for (auto &op
            : ops) { std::cout << " " << op; };
       std::cout << std::endl;)
 
+  // Look up the result in the disk cache. Results are stored for a unit
+  // factor and only for exact coefficients
+  std::string key;
+  if (not(disk_cache_path_.empty() or floating_point_coefficients())) {
+    key = disk_cache_key(ops, minrank, maxrank, linked_ops);
+    Expression cached;
+    if (read_disk_cache(key, cached)) {
+      timers_["disk cache hits"] += 1;
+      Expression result;
+      result.add(cached, factor);
+      return result;
+    }
+    timers_["disk cache misses"] += 1;
+  }
+  const scalar_t search_factor = key.empty() ? factor : scalar_t(1);
+
   // Step 1. Generate elementary contractions
   timer t1;
   elementary_contractions_ = generate_elementary_contractions(ops);
   timers_["step 1"] += t1.get();
 
-  // Step 2. Generate allowed composite contractions
-  timer t2;
-  generate_composite_contractions(ops, minrank, maxrank);
-  timers_["step 2"] += t2.get();
-
+  // Step 2. Generate allowed composite contractions and
   // Step 3. Process contractions
-  timer t3;
-  Expression result = process_contractions(factor, ops, minrank, maxrank);
-  timers_["step 3"] += t3.get();
+  // These two steps are fused: each contraction is processed as soon as it is
+  // found, so that contractions are never stored
+  Expression result = generate_composite_contractions(
+      search_factor, ops, minrank, maxrank, linked_ops);
+
+  if (not key.empty()) {
+    // a failure to write only means that the result is not reused, so it is
+    // reported once for each object and its copies (and counted)
+    if (not write_disk_cache(key, result)) {
+      if (not disk_cache_warned_->exchange(true)) {
+        std::cerr << "\nWarning: WickTheorem could not write to the disk cache "
+                  << disk_cache_path_ << std::endl;
+      }
+      timers_["disk cache write failures"] += 1;
+    }
+    Expression scaled_result;
+    scaled_result.add(result, factor);
+    return scaled_result;
+  }
   return result;
 }
 
-Expression WickTheorem::contract(scalar_t factor,
-                                 const OperatorExpression &expr,
-                                 const int minrank, const int maxrank) {
+void WickTheorem::check_contraction_cache() {
+  // the canonical terms also depend on the declared tensor symmetries and on
+  // the type of coefficients
+  contraction_cache_->check_spaces(
+      orbital_subspaces->str() + tensor_symmetries_str() +
+      (floating_point_coefficients() ? "floating point" : ""));
+}
+
+Expression WickTheorem::contract_products(
+    scalar_t factor,
+    const std::vector<std::tuple<OperatorProduct, scalar_t, std::uint64_t>>
+        &products,
+    const int minrank, const int maxrank) {
+  // check the cache once, before the threads start
+  check_contraction_cache();
+
+  // printing is only meaningful when the products are contracted in order
+  int nthreads = (print_ == PrintLevel::None) ? num_threads_ : 1;
+  nthreads = std::min(nthreads, static_cast<int>(products.size()));
+
+  if (nthreads <= 1) {
+    Expression result;
+    for (const auto &[ops, f, linked_ops] : products) {
+      result += contract_product(factor * f, ops, minrank, maxrank, linked_ops);
+    }
+    return result;
+  }
+
+  // Each thread works on a private copy of this object, so that the scratch
+  // space used in steps 1-3 (elementary contractions, contractions, timers) is
+  // never shared
+  WickTheorem worker(*this);
+  worker.num_threads_ = 1;
+  worker.timers_.clear();
+  std::vector<WickTheorem> workers(nthreads, worker);
+
+  std::vector<Expression> partial_results(products.size());
+  parallel_for(products.size(), nthreads, [&](int n, int thread) {
+    const auto &[ops, f, linked_ops] = products[n];
+    partial_results[n] = workers[thread].contract_product(
+        factor * f, ops, minrank, maxrank, linked_ops);
+  });
+
+  // Merge the partial results in the order of the products, so that the
+  // result does not depend on the number of threads. The timers of the
+  // workers are accumulated, so they report the total time spent by all
+  // threads
   Expression result;
-  for (const auto &[ops, f] : expr.terms()) {
-    result += contract(factor * f, ops, minrank, maxrank);
+  for (const auto &partial_result : partial_results) {
+    result += partial_result;
+  }
+  for (const auto &w : workers) {
+    for (const auto &[name, time] : w.timers_) {
+      timers_[name] += time;
+    }
   }
   return result;
 }
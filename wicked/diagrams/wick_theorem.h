@@ -1,7 +1,13 @@
 #ifndef _wicked_diag_theorem_h_
 #define _wicked_diag_theorem_h_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 class SQOperator;
@@ -13,6 +19,7 @@ class OperatorExpression;
 class GraphMatrix;
 class ElementaryContraction;
 class CompositeContraction;
+class ContractionCache;
 
 #include "../algebra/expression.h"
 
@@ -29,10 +36,32 @@ public:
   Expression contract(scalar_t factor, const OperatorProduct &ops,
                       const int minrank, const int maxrank);
 
-  /// Contract a product of sums of operators
+  /// Contract a product of sums of operators. When more than one thread is
+  /// requested the products are distributed among threads
   Expression contract(scalar_t factor, const OperatorExpression &expr,
                       const int minrank, const int maxrank);
 
+  /// Contract the commutator [A, B] = AB - BA. Only contractions that link the
+  /// operators of A to those of B are generated, since the other ones cancel
+  /// out (unless both operators have an odd number of second quantized
+  /// operators). A may itself be a commutator, so nested commutators like
+  /// [[H, T], T] can be contracted by passing commutator(H, T) as A
+  Expression contract_commutator(scalar_t factor, const OperatorExpression &A,
+                                 const OperatorExpression &B,
+                                 const int minrank, const int maxrank);
+
+  /// Count the contractions of a product of operators without processing
+  /// them (steps 1 and 2 only). Returns a map from the rank of the terms to
+  /// the number of contractions with that rank. The contractions are counted
+  /// without enumerating all of them, by caching the number of contractions
+  /// that can be reached from each partial contraction
+  std::map<int, long> count(const OperatorProduct &ops, const int minrank,
+                            const int maxrank);
+
+  /// Count the contractions of each product in a sum of operators
+  std::vector<std::pair<OperatorProduct, std::map<int, long>>>
+  count(const OperatorExpression &expr, const int minrank, const int maxrank);
+
   /// Set the amount of printing
   void set_print(PrintLevel print);
 
@@ -42,16 +71,49 @@ public:
   /// Set the maximum cumulant level
   void set_max_cumulant(int val);
 
+  /// Generate only contractions that connect all the operators in a product.
+  /// Disconnected terms cancel out in commutators of operators with an even
+  /// number of second quantized operators, so this option does not change the
+  /// result of contracting commutators (e.g., the output of bch_series)
+  void set_connected_only(bool val);
+
+  /// Set the number of threads used to contract an OperatorExpression or a
+  /// single OperatorProduct
+  void set_num_threads(int n);
+
+  /// Return the number of threads
+  int num_threads() const;
+
+  /// Turn on/off the cache of evaluated contractions (off by default).
+  /// Contractions with the same canonical graph are evaluated only once, and
+  /// the result is reused for all the products contracted by this object (and
+  /// its copies). The canonical form of each contraction graph is cached too,
+  /// so a contraction seen before is not canonicalized again. The elementary
+  /// contractions of the products are always cached, since they are generated
+  /// only once for all the products with the same sequence of graph matrices
+  void set_use_contraction_cache(bool val);
+
+  /// Set the largest number of contractions (canonical graphs, elementary
+  /// contractions) stored in the cache (100000 by default). When the cache is
+  /// full the element stored first is removed. The cache is emptied
+  void set_contraction_cache_max_size(int n);
+
+  /// Remove all the contractions stored in the cache
+  void clear_contraction_cache();
+
+  /// Store the result of contracting each product of operators in a
+  /// directory, so that it can be reused by later runs. Results are stored
+  /// separately for each definition of the orbital spaces, rank window, and
+  /// option of this class. Several processes may share the same directory. An
+  /// empty path turns off the disk cache
+  void set_disk_cache(const std::string &path);
+
   const std::map<std::string, double> &timers() const;
 
 private:
   /// A vector of elementary contractions
   std::vector<ElementaryContraction> elementary_contractions_;
 
-  /// The allowed contractions stored as a vector of indices of elementary
-  /// contractions
-  std::vector<std::vector<int>> contractions_;
-
   std::map<std::string, double> timers_;
 
   /// The number of contractions found
@@ -66,6 +128,149 @@ private:
   /// The default print level
   PrintLevel print_ = PrintLevel::None;
 
+  /// The number of threads
+  int num_threads_ = 1;
+
+  /// Generate only connected contractions?
+  bool connected_only_ = false;
+
+  /// Use the cache of processed contractions?
+  bool use_contraction_cache_ = false;
+
+  /// The cache of processed contractions. It is shared by the copies of this
+  /// object used by different threads
+  std::shared_ptr<ContractionCache> contraction_cache_;
+
+  /// The directory used to store the results of contractions. If empty the
+  /// disk cache is not used
+  std::string disk_cache_path_;
+
+  /// Was a failure to write to the disk cache reported? It is shared by the
+  /// copies of this object used by different threads, so that the failure is
+  /// reported only once
+  std::shared_ptr<std::atomic<bool>> disk_cache_warned_;
+
+  /// The orbital space of each elementary contraction
+  std::vector<int> elementary_contractions_space_;
+
+  /// The operators connected by each elementary contraction stored as a bit
+  /// mask
+  std::vector<std::uint64_t> elementary_contractions_ops_;
+
+  /// A leg of a product of operators (the creation or annihilation operators
+  /// of one operator in one space) that appears in elementary contractions
+  struct CandidateLeg {
+    /// The operator and space of this leg
+    int op;
+    int space;
+    /// Is this a leg of creation operators?
+    bool cre;
+    /// The number of operators in this leg
+    int count;
+    /// The position of the bit sets of this leg in candidate_table_
+    int offset;
+  };
+
+  /// The legs of the operators used to look up candidate contractions
+  std::vector<CandidateLeg> candidate_legs_;
+
+  /// For each leg with n free operators, a bit set of the elementary
+  /// contractions that use at most n operators of the leg. The bit set of leg
+  /// l starts at word (candidate_legs_[l].offset + n) * candidate_words_
+  std::vector<std::uint64_t> candidate_table_;
+
+  /// The number of 64-bit words in a bit set of elementary contractions
+  int candidate_words_ = 0;
+
+  /// The state of a search for the composite contractions of a product of
+  /// operators. Contractions found by the backtracking algorithm (step 2) are
+  /// processed as soon as they are found (step 3) and the resulting terms are
+  /// accumulated in result. Each thread works on its own search object
+  struct ContractionSearch {
+    /// The operators contracted
+    const OperatorProduct &ops;
+    /// The factor that multiplies the product of operators
+    scalar_t factor;
+    /// The range of ranks of the terms to keep
+    int minrank;
+    int maxrank;
+    /// If not zero, keep only contractions that link the operators in this bit
+    /// mask to the other operators
+    std::uint64_t linked_ops = 0;
+    /// The sum of the terms generated
+    Expression result;
+    /// The number of contractions processed
+    int ncontractions = 0;
+    /// The number of nodes of the search tree visited
+    long nnodes = 0;
+    /// The number of nodes of the search tree pruned
+    long npruned = 0;
+    /// The number of nodes of the search tree without children
+    long nleaves = 0;
+    /// Timers for the operations performed in this search
+    std::map<std::string, double> timers;
+  };
+
+  /// The scratch space used by the backtracking algorithm. It is allocated
+  /// once for each search (and thread) with room for the deepest level of the
+  /// search tree, so that visiting a node requires no memory allocation
+  struct BacktrackArena {
+    /// Allocate space for a search tree with at most max_depth levels and
+    /// ncontr elementary contractions
+    BacktrackArena(int max_depth, int ncontr);
+    /// The elementary contractions of the current solution
+    std::vector<int> a;
+    /// The position of the next candidate to try at each level
+    std::vector<int> next;
+    /// The candidates of each level
+    std::vector<std::vector<int>> candidates;
+    /// The bit set of candidates
+    std::vector<std::uint64_t> candidate_bits;
+  };
+
+  /// Contract a product of operators. If linked_ops is not zero, keep only
+  /// contractions that link the operators in this bit mask to the other ones.
+  /// The caller must call check_contraction_cache() first
+  Expression contract_product(scalar_t factor, const OperatorProduct &ops,
+                              const int minrank, const int maxrank,
+                              std::uint64_t linked_ops);
+
+  /// Count the contractions of a product of operators (see count). The caller
+  /// must call check_contraction_cache() first
+  std::map<int, long> count_product(const OperatorProduct &ops,
+                                    const int minrank, const int maxrank);
+
+  /// Empty the cache of processed contractions if the orbital spaces (or
+  /// anything else that determines the terms) changed since it was filled
+  void check_contraction_cache();
+
+  /// Contract a list of products of operators (product, factor, linked_ops).
+  /// When more than one thread is requested the products are distributed
+  /// among threads
+  Expression contract_products(
+      scalar_t factor,
+      const std::vector<std::tuple<OperatorProduct, scalar_t, std::uint64_t>>
+          &products,
+      const int minrank, const int maxrank);
+
+  //
+  // Functions for the disk cache
+  // implemented in wick_theorem_disk_cache.cc
+  //
+
+  /// The key used to store the result of contracting a product of operators.
+  /// It includes everything that determines the result
+  std::string disk_cache_key(const OperatorProduct &ops, const int minrank,
+                             const int maxrank, std::uint64_t linked_ops) const;
+
+  /// Read the result of a contraction from the disk cache. Returns false if
+  /// the result is not found
+  bool read_disk_cache(const std::string &key, Expression &result) const;
+
+  /// Write the result of a contraction to the disk cache. Returns false if the
+  /// result could not be written. Never throws
+  bool write_disk_cache(const std::string &key, const Expression &result) const;
+
   //
   // Functions for step 1. of the Wick's theorem algorithm
   // implemented in wich_theorem_elementary_contractions.cc
@@ -96,31 +301,112 @@ private:
   //
 
   /// Generates all composite contractions for a given contraction
-  /// pattern stored in ops
-  void generate_composite_contractions(const OperatorProduct &ops,
-                                       const int minrank, const int maxrank);
+  /// pattern stored in ops and processes them
+  Expression generate_composite_contractions(scalar_t factor,
+                                             const OperatorProduct &ops,
+                                             const int minrank,
+                                             const int maxrank,
+                                             std::uint64_t linked_ops);
 
   /// Backtracking algorithm used to generate all contractions product of
-  /// elementary contractions
+  /// elementary contractions. Explores the subtree rooted at the partial
+  /// contraction arena.a[0], ..., arena.a[k - 1] using an explicit stack
   void generate_contractions_backtrack(
-      std::vector<int> a, int k,
+      int k, const std::vector<ElementaryContraction> &el_contr_vec,
+      std::vector<GraphMatrix> &free_graph_matrix_vec, BacktrackArena &arena,
+      ContractionSearch &search);
+
+  /// Prepare the tables used to search the composite contractions of a
+  /// product of operators
+  void prepare_search(const OperatorProduct &ops, std::uint64_t linked_ops);
+
+  /// The state of a partial contraction that determines the contractions
+  /// that can be reached from it: the free graph matrices, the last
+  /// elementary contraction used, and when needed the connected components
+  /// and whether the linked operators are linked
+  using CountKey =
+      std::tuple<std::vector<GraphMatrix>, int, std::vector<std::uint64_t>>;
+
+  /// Count the composite contractions of a product of operators for each
+  /// rank of the terms
+  std::map<int, long> count_composite_contractions(const OperatorProduct &ops,
+                                                   const int minrank,
+                                                   const int maxrank);
+
+  /// Return the number of contractions for each rank that can be reached from
+  /// the partial contraction arena.a[0], ..., arena.a[k - 1]. The results are
+  /// cached in memo
+  std::vector<long>
+  count_backtrack(int k, const std::vector<ElementaryContraction> &el_contr_vec,
+                  std::vector<GraphMatrix> &free_graph_matrix_vec,
+                  BacktrackArena &arena, ContractionSearch &search,
+                  std::map<CountKey, std::vector<long>> &memo);
+
+  /// Find the candidates for the children of the node arena.a[0], ...,
+  /// arena.a[k - 1] and store them in arena.candidates[k + 1]. Return false if
+  /// no contraction in the subtree rooted at this node can be kept
+  bool expand_node(int k,
+                   const std::vector<GraphMatrix> &free_graph_matrix_vec,
+                   BacktrackArena &arena, const ContractionSearch &search);
+
+  /// Parallel version of the backtracking algorithm. The first levels of the
+  /// search tree are split into tasks that are distributed among threads
+  void generate_contractions_parallel(
       const std::vector<ElementaryContraction> &el_contr_vec,
-      std::vector<GraphMatrix> &free_graph_matrix_vec, const int minrank,
-      const int maxrank);
+      const std::vector<GraphMatrix> &free_graph_matrix_vec,
+      ContractionSearch &search, int nthreads);
 
-  /// Process a contraction (store it) found by the backtracking algorithm
+  /// Process a contraction found by the backtracking algorithm. If the rank
+  /// of the contraction is in the range requested it is passed to step 3.
   void
   process_contraction(const std::vector<int> &a, int k,
                       const std::vector<GraphMatrix> &free_graph_matrix_vec,
-                      const int minrank, const int maxrank);
-
-  /// Return a vector of indices of elementary contractions that can be added to
-  /// the current backtracking solution. All candidates generated here lead to
-  /// valid contractions
-  std::vector<int>
-  construct_candidates(std::vector<int> &a, int k,
-                       const std::vector<ElementaryContraction> &el_contr_vec,
-                       const std::vector<GraphMatrix> &free_graph_matrix_vec);
+                      ContractionSearch &search);
+
+  /// Return true if the contraction a[0], ..., a[k - 1] is kept, that is, its
+  /// rank is in the range requested and it is connected (linked) if required
+  bool is_kept(const std::vector<int> &a, int k,
+               const std::vector<GraphMatrix> &free_graph_matrix_vec,
+               const ContractionSearch &search) const;
+
+  /// Return true if no contraction in the subtree rooted at the partial
+  /// contraction a[0], ..., a[k - 1] has a rank in the range requested
+  bool is_prunable(const std::vector<int> &a, int k,
+                   const std::vector<GraphMatrix> &free_graph_matrix_vec,
+                   const ContractionSearch &search) const;
+
+  /// Find the connected components (bit masks of operators) of the graph
+  /// formed by the contractions a[0], ..., a[k - 1] and return their number
+  int connected_components(const std::vector<int> &a, int k, int nops,
+                           std::array<std::uint64_t, 64> &components) const;
+
+  /// Return true if one of the contractions a[0], ..., a[k - 1] links the
+  /// operators in the bit mask linked_ops to the other operators
+  bool is_linked(const std::vector<int> &a, int k,
+                 std::uint64_t linked_ops) const;
+
+  /// Return true if the contractions a[0], ..., a[k - 1] can be completed
+  /// with the candidates to give a contraction that links the operators in
+  /// the bit mask linked_ops to the other operators
+  bool can_be_linked(const std::vector<int> &a, int k, std::uint64_t linked_ops,
+                     const std::vector<int> &candidates) const;
+
+  /// Return true if the contractions a[0], ..., a[k - 1] can be completed
+  /// with the candidates to give a connected contraction
+  bool can_be_connected(const std::vector<int> &a, int k, int nops,
+                        const std::vector<int> &candidates) const;
+
+  /// Build the tables used to look up the elementary contractions compatible
+  /// with a set of free operators
+  void build_candidate_tables(const OperatorProduct &ops);
+
+  /// Find the indices of elementary contractions that can be added to the
+  /// current backtracking solution and store them in candidates. All
+  /// candidates generated here lead to valid contractions
+  void construct_candidates(const std::vector<int> &a, int k,
+                            const std::vector<GraphMatrix> &free_graph_matrix_vec,
+                            std::vector<std::uint64_t> &bits,
+                            std::vector<int> &candidates) const;
 
   /// Applies a contraction to the list of free graph matrices. Used in
   /// backtracking algorithm
@@ -139,9 +425,10 @@ private:
   // implemented in wich_theorem_process_contractions.cc
   //
 
-  /// Process the contractions generated in step 2.
-  Expression process_contractions(scalar_t factor, const OperatorProduct &ops,
-                                  const int minrank, const int maxrank);
+  /// Turn a contraction generated in step 2. into a term and add it to the
+  /// result of a search
+  void add_contraction_term(const std::vector<int> &a, int k,
+                            ContractionSearch &search);
 
   /// Apply the contraction to this set of operators and produce a term
   std::pair<SymbolicTerm, scalar_t>
@@ -150,15 +437,19 @@ private:
                        scalar_t factor);
 
   /// Return the tensors and operators correspoding to a product of operators
-  std::tuple<std::vector<Tensor>, std::vector<SQOperator>,
-             std::map<std::tuple<int, int, bool, int>, int>>
+  /// and the table of the positions of the operators (see elements_vec_to_pos)
+  std::tuple<std::vector<Tensor>, std::vector<SQOperator>, std::vector<int>>
   contraction_tensors_sqops(const OperatorProduct &ops);
 
+  /// Return the positions of the creation (annihilation) operators of an
+  /// elementary contraction and update the number of operators contracted
+  /// (ops_offset). sqop_pos stores the position of the first creation and
+  /// annihilation operator of each operator and space
   std::vector<int>
-  elements_vec_to_pos(const ElementaryContraction &elements_vec,
+  elements_vec_to_pos(const OperatorProduct &ops,
+                      const ElementaryContraction &elements_vec,
                       std::vector<GraphMatrix> &ops_offset,
-                      std::map<std::tuple<int, int, bool, int>, int> &op_map,
-                      bool creation);
+                      const std::vector<int> &sqop_pos, bool creation);
 
   /// Return the combinatorial factor corresponding to a contraction pattern
   scalar_t combinatorial_factor(const OperatorProduct &ops,
@@ -168,6 +459,13 @@ private:
   std::tuple<OperatorProduct, CompositeContraction, scalar_t>
   canonicalize_contraction_graph(const OperatorProduct &ops,
                                  const CompositeContraction &contractions);
+
+  /// Return the permutations of the operators and of the contractions that
+  /// give the canonical contraction graph and the sign of the permutation of
+  /// the operators
+  std::tuple<std::vector<int>, std::vector<int>, scalar_t>
+  canonical_contraction_graph_order(const OperatorProduct &ops,
+                                    const CompositeContraction &contractions);
 };
 
 #endif // _wicked_diag_theorem_h_
@@ -42,42 +42,15 @@ std::string contraction_signature(const OperatorProduct &ops,
                                   const std::vector<int> &ops_perm,
                                   const std::vector<int> &contr_perm);
 
-using namespace std;
+std::pair<OperatorProduct, CompositeContraction>
+permute_contraction_graph(const OperatorProduct &ops,
+                          const CompositeContraction &contractions,
+                          const std::vector<int> &ops_perm,
+                          const std::vector<int> &contr_perm);
 
-std::pair<bool, scalar_t>
-is_ops_permutation_valid(const OperatorProduct &ops, std::vector<int> ops_perm,
-                         const std::vector<std::vector<bool>> &permutable) {
-  // ok, so we are given a permutation of some operators and a matrix that tells
-  // us which operators/contractions commute. Let's find out if this permutation
-  // is consistent with the allowed permutations.
-
-  // Here we reorder the operators one by one and in the process check if
-  // this permutation is allowed. We also keep track of the sign, which
-  // depends on the number of second quantized operators permuted
-  scalar_t sign{1};
-  int n = ops_perm.size();
-  for (int i = 0; i < n - 1; i++) {
-    // Last i elements are already in place
-    for (int j = 0; j < n - i - 1; j++) {
-      if (ops_perm[j + 1] < ops_perm[j]) {
-        // permutable
-        if (permutable[ops_perm[j + 1]][ops_perm[j]]) {
-          // the parity is given by the product of number of operators
-          sign *= 1 - 2 * ((ops[ops_perm[j + 1]].num_ops() *
-                            ops[ops_perm[j]].num_ops()) %
-                           2);
-          swap(ops_perm[j], ops_perm[j + 1]);
-        } else {
-          // this permutation is not valid
-          return std::pair(false, scalar_t(1));
-        }
-      }
-    }
-  }
-  return std::pair(true, sign);
-}
+using namespace std;
 
-bool do_contractions_commute(int i, int j, const OperatorProduct &ops,
+bool do_contractions_commute(int i, int j,
                              const CompositeContraction &contractions) {
   // contractions commute if rearranging two operators does not change the final
   // result
@@ -100,55 +73,232 @@ bool do_contractions_commute(int i, int j, const OperatorProduct &ops,
   return do_commute;
 }
 
-bool graph_less(const std::pair<int, int> &l, const std::pair<int, int> &r,
-                const std::vector<std::vector<int>> &ops_perms,
-                std::vector<std::vector<int>> &con_perms,
-                const OperatorProduct &ops,
-                const CompositeContraction &contractions) {
-  // here we are given the indices of the permutations of the operators and we
-  // have to determine if permutation l is less than r
-
-  const auto &l_ops_perm = ops_perms[l.first];
-  const auto &r_ops_perm = ops_perms[r.first];
-  const auto &l_con_perm = con_perms[l.second];
-  const auto &r_con_perm = con_perms[r.second];
-
-  // first compare the operators
-  // consider three cases:
-  // 1.  lops <  rops (return true)
-  // 2.  lops == rops (must check the contractions)
-  // 3.  lops >  rops (return false)
-  const int no = l_ops_perm.size();
-  for (int i = 0; i < no; i++) {
-    if (ops[l_ops_perm[i]] < ops[r_ops_perm[i]]) {
-      return true;
+
+/// Search for the canonical form of a contraction graph.
+///
+/// The canonical graph is the smallest one according to the following order:
+/// first the sequence of operators is compared lexicographically, then the
+/// contractions (permuted in the same way as the operators) are compared one
+/// by one, with larger contractions coming first. The operators can only be
+/// permuted in ways that do not change the value of the contraction, so the
+/// allowed orders are the linear extensions of the partial order given by the
+/// pairs of operators that do not commute.
+///
+/// Instead of enumerating all the permutations of the operators and of the
+/// contractions, the operators are placed one at a time choosing the smallest
+/// of those that can be moved to the next position (individualization), and
+/// the search branches only when several equal operators can be placed. Two
+/// equal operators that are touched by the same contractions in the same way
+/// are interchangeable, so only the first one is tried. For a given order of
+/// the operators the best order of the contractions is found by sorting them.
+/// Among graphs that compare equal the one reached by the smallest permutation
+/// of the operators is selected.
+class CanonicalGraphSearch {
+public:
+  CanonicalGraphSearch(const OperatorProduct &ops,
+                       const CompositeContraction &contractions,
+                       const std::vector<std::vector<bool>> &commutable)
+      : ops_(ops), contractions_(contractions), commutable_(commutable),
+        nops_(ops.size()), placed_(nops_, false) {
+    // find operators that are interchangeable
+    twins_.assign(nops_, std::vector<bool>(nops_, false));
+    for (int i = 0; i < nops_; i++) {
+      for (int j = i + 1; j < nops_; j++) {
+        bool twins = ops_[i] == ops_[j];
+        for (const auto &contr : contractions_) {
+          twins = twins and (contr[i] == contr[j]);
+        }
+        twins_[i][j] = twins_[j][i] = twins;
+      }
     }
-    if (ops[r_ops_perm[i]] < ops[l_ops_perm[i]]) {
-      return false;
+    ops_perm_.reserve(nops_);
+  }
+
+  void run() { search(false); }
+
+  /// the number of complete operator orders examined
+  int nleaves() const { return nleaves_; }
+  const std::vector<int> &ops_perm() const { return best_ops_perm_; }
+  const std::vector<int> &contr_perm() const { return best_contr_perm_; }
+
+  /// the sign of the canonical permutation of the operators. Each pair of
+  /// operators that is inverted contributes a factor (-1)^(n_i * n_j), where
+  /// n_i is the number of second quantized operators in operator i
+  scalar_t sign() const {
+    std::vector<int> position(nops_);
+    for (int p = 0; p < nops_; p++) {
+      position[best_ops_perm_[p]] = p;
     }
+    int parity = 0;
+    for (int i = 0; i < nops_; i++) {
+      for (int j = i + 1; j < nops_; j++) {
+        if (position[j] < position[i]) {
+          parity += ops_[i].num_ops() * ops_[j].num_ops();
+        }
+      }
+    }
+    return scalar_t(1 - 2 * (parity % 2));
   }
 
-  // if we made it here lops == rops
-  const int nc = l_con_perm.size();
-  // loop over all the contractions permuted
-  for (int j = 0; j < nc; j++) {
-    const auto &l_con = contractions[l_con_perm[j]];
-    const auto &r_con = contractions[r_con_perm[j]];
-    for (int i = 0; i < no; i++) {
-      if (l_con[l_ops_perm[i]] < r_con[r_ops_perm[i]]) {
+private:
+  const OperatorProduct &ops_;
+  const CompositeContraction &contractions_;
+  const std::vector<std::vector<bool>> &commutable_;
+  const int nops_;
+  std::vector<std::vector<bool>> twins_;
+
+  // the current partial order of the operators
+  std::vector<int> ops_perm_;
+  std::vector<bool> placed_;
+
+  // the best graph found so far
+  std::vector<int> best_ops_perm_;
+  std::vector<int> best_contr_perm_;
+  int nleaves_ = 0;
+  int nupdates_ = 0;
+
+  /// can operator i be placed after the operators already placed?
+  bool is_available(int i) const {
+    if (placed_[i])
+      return false;
+    for (int k = 0; k < i; k++) {
+      if ((not placed_[k]) and (not commutable_[k][i]))
         return false;
+    }
+    return true;
+  }
+
+  /// extend the current order of the operators. If improved is true the
+  /// current partial sequence of operators is already smaller than the best
+  void search(bool improved) {
+    const int pos = ops_perm_.size();
+    if (pos == nops_) {
+      process_leaf(improved);
+      return;
+    }
+
+    // find the smallest operator that can be placed at this position
+    int min_op = -1;
+    for (int i = 0; i < nops_; i++) {
+      if (is_available(i) and ((min_op < 0) or (ops_[i] < ops_[min_op]))) {
+        min_op = i;
       }
-      if (r_con[r_ops_perm[i]] < l_con[l_ops_perm[i]]) {
-        return true;
+    }
+
+    // compare with the best sequence found so far
+    if ((not improved) and (not best_ops_perm_.empty())) {
+      const auto &best_op = ops_[best_ops_perm_[pos]];
+      if (best_op < ops_[min_op])
+        return;
+      improved = ops_[min_op] < best_op;
+    }
+
+    // branch over the equal operators, skipping those interchangeable with an
+    // operator already tried
+    std::vector<int> tried;
+    for (int i = min_op; i < nops_; i++) {
+      if ((not is_available(i)) or (not(ops_[i] == ops_[min_op])))
+        continue;
+      bool is_twin = false;
+      for (int t : tried) {
+        is_twin = is_twin or twins_[t][i];
       }
+      if (is_twin)
+        continue;
+      tried.push_back(i);
+
+      const int nupdates = nupdates_;
+      ops_perm_.push_back(i);
+      placed_[i] = true;
+      search(improved);
+      placed_[i] = false;
+      ops_perm_.pop_back();
+      // if a better graph was found, it has the same operators as the current
+      // sequence up to this position
+      if (nupdates_ != nupdates)
+        improved = false;
     }
   }
-  return false;
-}
+
+  /// compare two contractions permuted according to the current order of
+  /// the operators
+  int compare_contractions(int c, int d, const std::vector<int> &c_ops_perm,
+                           const std::vector<int> &d_ops_perm) const {
+    for (int i = 0; i < nops_; i++) {
+      const auto &lhs = contractions_[c][c_ops_perm[i]];
+      const auto &rhs = contractions_[d][d_ops_perm[i]];
+      if (lhs < rhs)
+        return -1;
+      if (rhs < lhs)
+        return 1;
+    }
+    return 0;
+  }
+
+  void process_leaf(bool improved) {
+    nleaves_++;
+    // the contractions are sorted in decreasing order
+    std::vector<int> contr_perm = iota_vector<int>(contractions_.size());
+    std::stable_sort(contr_perm.begin(), contr_perm.end(), [&](int c, int d) {
+      return compare_contractions(c, d, ops_perm_, ops_perm_) > 0;
+    });
+
+    if (not(improved or best_ops_perm_.empty())) {
+      // the operators are the same, compare the contractions
+      for (size_t j = 0; j < contr_perm.size(); j++) {
+        int cmp = compare_contractions(contr_perm[j], best_contr_perm_[j],
+                                       ops_perm_, best_ops_perm_);
+        if (cmp < 0)
+          return;
+        if (cmp > 0) {
+          improved = true;
+          break;
+        }
+      }
+      if (not improved)
+        return;
+    }
+    best_ops_perm_ = ops_perm_;
+    best_contr_perm_ = contr_perm;
+    nupdates_++;
+  }
+};
 
 std::tuple<OperatorProduct, CompositeContraction, scalar_t>
 WickTheorem::canonicalize_contraction_graph(
     const OperatorProduct &ops, const CompositeContraction &contractions) {
+  const auto [ops_perm, contr_perm, sign] =
+      canonical_contraction_graph_order(ops, contractions);
+  const auto [canonical_ops, canonical_contr] =
+      permute_contraction_graph(ops, contractions, ops_perm, contr_perm);
+  return std::make_tuple(canonical_ops, canonical_contr, sign);
+}
+
+std::pair<OperatorProduct, CompositeContraction>
+permute_contraction_graph(const OperatorProduct &ops,
+                          const CompositeContraction &contractions,
+                          const std::vector<int> &ops_perm,
+                          const std::vector<int> &contr_perm) {
+  OperatorProduct permuted_ops;
+  for (int o : ops_perm) {
+    permuted_ops.push_back(ops[o]);
+  }
+
+  // permute the order and operator upon a contraction acts
+  CompositeContraction permuted_contr;
+  for (int c : contr_perm) {
+    std::vector<GraphMatrix> permuted_el_contr;
+    for (int o : ops_perm) {
+      permuted_el_contr.push_back(contractions[c][o]);
+    }
+    permuted_contr.push_back(permuted_el_contr);
+  }
+  return std::make_pair(permuted_ops, permuted_contr);
+}
+
+std::tuple<std::vector<int>, std::vector<int>, scalar_t>
+WickTheorem::canonical_contraction_graph_order(
+    const OperatorProduct &ops, const CompositeContraction &contractions) {
 
   PRINT(PrintLevel::Detailed,
         cout << "  Graph of the contraction to canonicalize:" << endl;
@@ -166,7 +316,7 @@ WickTheorem::canonicalize_contraction_graph(
   for (int i = 0; i < nops; i++) {
     for (int j = 0; j < nops; j++) {
       // check if commuting operators i and j changes the contraction
-      if (do_contractions_commute(i, j, ops, contractions)) {
+      if (do_contractions_commute(i, j, contractions)) {
         commutable[i][j] = true;
       }
     }
@@ -182,99 +332,30 @@ WickTheorem::canonicalize_contraction_graph(
       };
       cout << endl;);
 
-  // 1. Generate all possible permutation of operators
-  // these vectors store the allowed permutations
-  std::vector<std::vector<int>> ops_perms;
-  std::vector<scalar_t> ops_perms_sign;
-  {
-    // Loop over all permutations of operators
-    std::vector<int> ops_perm(ops.size());
-    std::iota(ops_perm.begin(), ops_perm.end(), 0);
-    do {
-      if (const auto [is_valid, sign] =
-              is_ops_permutation_valid(ops, ops_perm, commutable);
-          is_valid) {
-        ops_perms.push_back(ops_perm);
-        ops_perms_sign.push_back(sign);
-        PRINT(PrintLevel::Detailed, cout << "  Operator permutation: ";
-              PRINT_ELEMENTS(ops_perm);
-              cout << ", sign = " << sign.repr() << " (allowed)" << endl;);
-      } else {
-        PRINT(PrintLevel::Detailed, cout << "  Operator permutation: ";
-              PRINT_ELEMENTS(ops_perm); cout << " (not allowed)" << endl;);
-      }
-    } while (std::next_permutation(ops_perm.begin(), ops_perm.end()));
-  }
-  PRINT(PrintLevel::Detailed, cout << "\n  Found " << ops_perms.size()
-                                   << " valid operator permutations\n"
-                                   << endl;);
-
-  std::vector<std::vector<int>> con_perms;
-  {
-    // Loop over all permutations of contractions
-    std::vector<int> con_perm(contractions.size());
-    std::iota(con_perm.begin(), con_perm.end(), 0);
-    do {
-      PRINT(PrintLevel::Detailed, cout << "  Contraction permutation: ";
-            PRINT_ELEMENTS(con_perm); cout << endl;);
-      con_perms.push_back(con_perm);
-    } while (std::next_permutation(con_perm.begin(), con_perm.end()));
-  }
-  PRINT(PrintLevel::Detailed, cout << "\n  Found " << con_perms.size()
-                                   << " valid contraction permutations\n"
-                                   << endl;);
-
-  // store all the possible graphs
-  std::vector<std::pair<int, int>> graphs;
-  for (const auto &[o, ops_perm] : enumerate(ops_perms)) {
-    for (const auto &[c, con_perm] : enumerate(con_perms)) {
-      graphs.push_back(std::pair(o, c));
-    }
-  }
-
-  PRINT(PrintLevel::Detailed,
-        cout << "  Found " << graphs.size() << " valid graphs" << endl;);
+  // find the canonical order of the operators and contractions
+  CanonicalGraphSearch search(ops, contractions, commutable);
+  search.run();
+  const auto &canonical_ops_perm = search.ops_perm();
+  const auto &canonical_contr_perm = search.contr_perm();
 
-  // sort all the graphs
-  std::sort(graphs.begin(), graphs.end(),
-            [&](const std::pair<int, int> &l, const std::pair<int, int> &r) {
-              return graph_less(l, r, ops_perms, con_perms, ops, contractions);
-            });
-
-  const auto [canonical_ops_perm_idx, canonical_contr_perm_idx] = graphs[0];
+  PRINT(PrintLevel::Detailed, cout << "  Examined " << search.nleaves()
+                                   << " operator permutations" << endl;);
 
   // Get the sign associated with rearranging the operators
-  const scalar_t canonical_sign = ops_perms_sign[canonical_ops_perm_idx];
-
-  // Get the canonical order of the operators
-  OperatorProduct canonical_ops;
-  for (int o : ops_perms[canonical_ops_perm_idx]) {
-    canonical_ops.push_back(ops[o]);
-  }
-
-  // Get the canonical order of the contractions
-  // permute the order and operator upon a contraction acts
-  CompositeContraction canonical_contr;
-  for (int c : con_perms[canonical_contr_perm_idx]) {
-    std::vector<GraphMatrix> permuted_contr;
-    for (int o : ops_perms[canonical_ops_perm_idx]) {
-      permuted_contr.push_back(contractions[c][o]);
-    }
-    canonical_contr.push_back(permuted_contr);
-  }
+  const scalar_t canonical_sign = search.sign();
 
   PRINT(PrintLevel::Detailed,
         cout << "\n  Canonical form of the contraction:" << endl;
         cout << "    Sign = " << canonical_sign.repr() << endl;
         cout << "    Operator permutation: ";
-        PRINT_ELEMENTS(ops_perms[canonical_ops_perm_idx]); cout << endl;
+        PRINT_ELEMENTS(canonical_ops_perm); cout << endl;
         cout << "    Contraction permutation: ";
-        PRINT_ELEMENTS(con_perms[canonical_contr_perm_idx]); cout << endl;
+        PRINT_ELEMENTS(canonical_contr_perm); cout << endl;
         cout << "    Graph of the canonical contraction:" << endl;
-        print_contraction_graph(ops, contractions,
-                                ops_perms[canonical_ops_perm_idx],
-                                con_perms[canonical_contr_perm_idx]);
+        print_contraction_graph(ops, contractions, canonical_ops_perm,
+                                canonical_contr_perm);
         cout << endl;);
 
-  return std::make_tuple(canonical_ops, canonical_contr, canonical_sign);
+  return std::make_tuple(canonical_ops_perm, canonical_contr_perm,
+                         canonical_sign);
 }
@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <vector>
 
 #include "fmt/format.h"
 
+#include "helpers/parallel.hpp"
+#include "helpers/timer.hpp"
+
 #include "contraction.h"
 #include "graph_matrix.h"
 #include "operator.h"
@@ -17,16 +24,21 @@
 
 using namespace std;
 
-void WickTheorem::generate_composite_contractions(const OperatorProduct &ops,
-                                                  const int minrank,
-                                                  const int maxrank) {
+// Return the largest number of elementary contractions in a composite
+// contraction of a product of operators. Each elementary contraction removes at
+// least two operators
+static int max_search_depth(const OperatorProduct &ops) {
+  return ops.num_ops() / 2 + 1;
+}
+
+Expression WickTheorem::generate_composite_contractions(
+    scalar_t factor, const OperatorProduct &ops, const int minrank,
+    const int maxrank, std::uint64_t linked_ops) {
   PRINT(PrintLevel::Summary,
-        std::cout << "\n- Step 2. Generating composite contractions"
+        std::cout << "\n- Step 2. Generating and processing composite "
+                     "contractions"
                   << std::endl;)
 
-  // this vector is used in the backtracking algorithm to hold the list of
-  // elementary contractions
-  std::vector<int> a(100, -1);
   // create a vector that keeps track of the free (uncontracted graph matrices)
   std::vector<GraphMatrix> free_graph_matrix_vec;
   for (const auto &op : ops) {
@@ -41,91 +53,578 @@ void WickTheorem::generate_composite_contractions(const OperatorProduct &ops,
         << "\n    "
            "----------------------------------------------------------";)
 
+  // The time spent in step 3 is measured for each contraction and subtracted
+  // from the time of the search. Like step 3, step 2 is timed by each task of
+  // a parallel search, so both timers add up the time of all threads
+  timer t2;
+  prepare_search(ops, linked_ops);
+
   // generate all contractions by backtracking
-  generate_contractions_backtrack(a, 0, elementary_contractions_,
-                                  free_graph_matrix_vec, minrank, maxrank);
-  PRINT(PrintLevel::Summary, std::cout << "\n\n    Total contractions: "
-                                       << ncontractions_ << std::endl;)
+  ContractionSearch search{ops, factor, minrank, maxrank, linked_ops};
+  int nthreads = (print_ == PrintLevel::None) ? num_threads_ : 1;
+  if (nthreads > 1) {
+    search.timers["step 2"] += t2.get();
+    generate_contractions_parallel(elementary_contractions_,
+                                   free_graph_matrix_vec, search, nthreads);
+  } else {
+    BacktrackArena arena(max_search_depth(ops),
+                         elementary_contractions_.size());
+    generate_contractions_backtrack(0, elementary_contractions_,
+                                    free_graph_matrix_vec, arena, search);
+    search.timers["step 2"] += t2.get() - search.timers["step 3"];
+  }
+  ncontractions_ = search.ncontractions;
+  for (const auto &[name, time] : search.timers) {
+    timers_[name] += time;
+  }
+  timers_["step 2 nodes"] += search.nnodes;
+  timers_["step 2 leaves"] += search.nleaves;
+  timers_["step 2 pruned nodes"] += search.npruned;
+  PRINT(PrintLevel::Summary,
+        std::cout << "\n\n    Total contractions: " << ncontractions_;
+        std::cout << "\n    Nodes visited:      " << search.nnodes;
+        std::cout << "\n    Leaves:             " << search.nleaves;
+        std::cout << "\n    Nodes pruned:       " << search.npruned
+                  << std::endl;)
+  if (ncontractions_ == 0) {
+    PRINT(PrintLevel::Summary, std::cout << "\n  No contractions generated\n"
+                                         << std::endl;)
+  }
+  return search.result;
+}
+
+void WickTheorem::prepare_search(const OperatorProduct &ops,
+                                 std::uint64_t linked_ops) {
+  // store the space of each elementary contraction and the operators it
+  // connects (used to prune the search)
+  int nops = ops.size();
+  if ((connected_only_ or linked_ops) and (nops > 64)) {
+    throw std::runtime_error(
+        "WickTheorem::prepare_search - connected contractions are supported "
+        "only for products of up to 64 operators");
+  }
+  elementary_contractions_space_.clear();
+  elementary_contractions_ops_.clear();
+  for (const auto &el_contr : elementary_contractions_) {
+    elementary_contractions_space_.push_back(
+        el_contr.spaces_in_elementary_contraction()[0]);
+    std::uint64_t mask = 0;
+    for (int A = 0; A < std::min(nops, 64); A++) {
+      if (el_contr[A].num_ops() > 0) {
+        mask |= std::uint64_t(1) << A;
+      }
+    }
+    elementary_contractions_ops_.push_back(mask);
+  }
+  build_candidate_tables(ops);
+}
+
+std::map<int, long>
+WickTheorem::count_composite_contractions(const OperatorProduct &ops,
+                                         const int minrank, const int maxrank) {
+  prepare_search(ops, 0);
+
+  std::vector<GraphMatrix> free_graph_matrix_vec;
+  for (const auto &op : ops) {
+    free_graph_matrix_vec.push_back(op.graph_matrix());
+  }
+
+  ContractionSearch search{ops, scalar_t(1), minrank, maxrank, 0};
+  BacktrackArena arena(max_search_depth(ops), elementary_contractions_.size());
+  std::map<CountKey, std::vector<long>> memo;
+  std::vector<long> counts =
+      count_backtrack(0, elementary_contractions_, free_graph_matrix_vec, arena,
+                      search, memo);
+  timers_["count states"] += search.nnodes;
+
+  std::map<int, long> result;
+  for (int rank = 0; rank < static_cast<int>(counts.size()); rank++) {
+    if (counts[rank] > 0) {
+      result[rank] = counts[rank];
+    }
+  }
+  return result;
+}
+
+std::vector<long> WickTheorem::count_backtrack(
+    int k, const std::vector<ElementaryContraction> &el_contr_vec,
+    std::vector<GraphMatrix> &free_graph_matrix_vec, BacktrackArena &arena,
+    ContractionSearch &search, std::map<CountKey, std::vector<long>> &memo) {
+  // find the state of this partial contraction and check if it was counted
+  std::vector<std::uint64_t> links;
+  if (search.linked_ops) {
+    links.push_back(is_linked(arena.a, k, search.linked_ops));
+  }
+  if (connected_only_) {
+    std::array<std::uint64_t, 64> components;
+    int ncomponents = connected_components(
+        arena.a, k, free_graph_matrix_vec.size(), components);
+    std::sort(components.begin(), components.begin() + ncomponents);
+    links.insert(links.end(), components.begin(),
+                 components.begin() + ncomponents);
+  }
+  CountKey key(free_graph_matrix_vec, (k > 0) ? arena.a[k - 1] : -1, links);
+  auto it = memo.find(key);
+  if (it != memo.end()) {
+    return it->second;
+  }
+
+  // count this contraction and those reachable from it
+  std::vector<long> counts(search.ops.num_ops() + 1, 0);
+  search.nnodes++;
+  if (expand_node(k, free_graph_matrix_vec, arena, search)) {
+    if (is_kept(arena.a, k, free_graph_matrix_vec, search)) {
+      counts[sum_num_ops(free_graph_matrix_vec)] += 1;
+    }
+    // the candidates of this level are not modified by the children
+    const auto &candidates = arena.candidates[k + 1];
+    for (int c : candidates) {
+      make_move(arena.a, k + 1, c, el_contr_vec, free_graph_matrix_vec);
+      std::vector<long> child_counts = count_backtrack(
+          k + 1, el_contr_vec, free_graph_matrix_vec, arena, search, memo);
+      for (int rank = 0; rank < static_cast<int>(counts.size()); rank++) {
+        counts[rank] += child_counts[rank];
+      }
+      unmake_move(arena.a, k + 1, c, el_contr_vec, free_graph_matrix_vec);
+    }
+  }
+  memo.emplace(key, counts);
+  return counts;
+}
+
+WickTheorem::BacktrackArena::BacktrackArena(int max_depth, int ncontr)
+    : a(max_depth, -1), next(max_depth + 1, 0), candidates(max_depth + 1),
+      candidate_bits((ncontr + 63) / 64) {
+  for (auto &level_candidates : candidates) {
+    level_candidates.reserve(ncontr);
+  }
 }
 
 void WickTheorem::generate_contractions_backtrack(
-    std::vector<int> a, int k,
-    const std::vector<ElementaryContraction> &el_contr_vec,
-    std::vector<GraphMatrix> &free_graph_matrix_vec, const int minrank,
-    const int maxrank) {
+    int k, const std::vector<ElementaryContraction> &el_contr_vec,
+    std::vector<GraphMatrix> &free_graph_matrix_vec, BacktrackArena &arena,
+    ContractionSearch &search) {
+  std::vector<int> &a = arena.a;
 
-  // process this contraction
-  process_contraction(a, k, free_graph_matrix_vec, minrank, maxrank);
+  // Visit a node: process its contraction and find its children. Return true
+  // if the children must be explored
+  auto visit = [&](int k) {
+    search.nnodes++;
+    if (not expand_node(k, free_graph_matrix_vec, arena, search)) {
+      search.npruned++;
+      return false;
+    }
+    process_contraction(a, k, free_graph_matrix_vec, search);
+    if (arena.candidates[k + 1].empty()) {
+      search.nleaves++;
+      return false;
+    }
+    return true;
+  };
+
+  // The stack holds the candidates of each level (arena.candidates[level])
+  // and the position of the next one to try (arena.next[level]). A candidate
+  // chosen at a given level is the contraction a[level - 1]
+  const int root = k;
+  if (not visit(root)) {
+    return;
+  }
+  int level = root + 1;
+  arena.next[level] = 0;
+  while (level > root) {
+    const auto &candidates = arena.candidates[level];
+    if (arena.next[level] < static_cast<int>(candidates.size())) {
+      // apply the next candidate and go one level down if needed
+      int c = candidates[arena.next[level]++];
+      make_move(a, level, c, el_contr_vec, free_graph_matrix_vec);
+      if (visit(level)) {
+        level++;
+        arena.next[level] = 0;
+      } else {
+        unmake_move(a, level, c, el_contr_vec, free_graph_matrix_vec);
+      }
+    } else {
+      // all candidates tried, go one level up and undo the move that led here
+      level--;
+      if (level > root) {
+        unmake_move(a, level, a[level - 1], el_contr_vec,
+                    free_graph_matrix_vec);
+      }
+    }
+  }
+}
+
+bool WickTheorem::expand_node(
+    int k, const std::vector<GraphMatrix> &free_graph_matrix_vec,
+    BacktrackArena &arena, const ContractionSearch &search) {
+  // skip this branch if it cannot lead to contractions of the right rank
+  if (is_prunable(arena.a, k, free_graph_matrix_vec, search)) {
+    return false;
+  }
 
   // build a list of candidate contractions to add to this solution
-  k = k + 1;
-  std::vector<int> candidates =
-      construct_candidates(a, k, el_contr_vec, free_graph_matrix_vec);
+  auto &candidates = arena.candidates[k + 1];
+  construct_candidates(arena.a, k + 1, free_graph_matrix_vec,
+                       arena.candidate_bits, candidates);
+
+  // skip this branch if it cannot lead to connected (linked) contractions
+  if (connected_only_ and not can_be_connected(arena.a, k,
+                                               free_graph_matrix_vec.size(),
+                                               candidates)) {
+    return false;
+  }
+  if (search.linked_ops and
+      not can_be_linked(arena.a, k, search.linked_ops, candidates)) {
+    return false;
+  }
+  return true;
+}
+
+void WickTheorem::generate_contractions_parallel(
+    const std::vector<ElementaryContraction> &el_contr_vec,
+    const std::vector<GraphMatrix> &free_graph_matrix_vec,
+    ContractionSearch &search, int nthreads) {
+  const int max_depth = max_search_depth(search.ops);
+  const int ncontr = el_contr_vec.size();
+
+  // Split the search tree into tasks. Each task is identified by a partial
+  // contraction (a prefix of the vector a). Prefixes shorter than split_depth
+  // are tasks that only process the prefix itself, while prefixes of length
+  // split_depth are tasks that process the entire subtree rooted at the
+  // prefix. The tasks are stored in the order in which the serial algorithm
+  // visits them and their results are merged in this order. The nodes of the
+  // subtrees are counted by their tasks, while the other nodes are counted in
+  // split_search, which is reset at every attempt.
+  timer t_split;
+  const int max_split_depth = 3;
+  const int min_tasks_per_thread = 8;
+  std::vector<std::pair<std::vector<int>, bool>> tasks;
+  BacktrackArena split_arena(max_depth, ncontr);
+  ContractionSearch split_search{search.ops, search.factor, search.minrank,
+                                 search.maxrank, search.linked_ops};
+  for (int split_depth = 1; split_depth <= max_split_depth; split_depth++) {
+    tasks.clear();
+    split_search.nnodes = split_search.npruned = split_search.nleaves = 0;
+    int nsubtrees = 0;
+    std::vector<int> &a = split_arena.a;
+    std::vector<GraphMatrix> free_vec(free_graph_matrix_vec);
+    std::function<void(int)> split = [&](int k) {
+      bool is_subtree = (k == split_depth);
+      if (not expand_node(k, free_vec, split_arena, split_search)) {
+        split_search.nnodes++;
+        split_search.npruned++;
+        return;
+      }
+      tasks.push_back(std::make_pair(
+          std::vector<int>(a.begin(), a.begin() + k), is_subtree));
+      if (is_subtree) {
+        nsubtrees++;
+        return;
+      }
+      split_search.nnodes++;
+      if (split_arena.candidates[k + 1].empty()) {
+        split_search.nleaves++;
+      }
+      // copy the candidates since the buffer is reused by the children
+      std::vector<int> candidates(split_arena.candidates[k + 1]);
+      for (int c : candidates) {
+        make_move(a, k + 1, c, el_contr_vec, free_vec);
+        split(k + 1);
+        unmake_move(a, k + 1, c, el_contr_vec, free_vec);
+      }
+    };
+    split(0);
+    if (nsubtrees >= min_tasks_per_thread * nthreads) {
+      break;
+    }
+  }
+  search.nnodes += split_search.nnodes;
+  search.npruned += split_search.npruned;
+  search.nleaves += split_search.nleaves;
+  search.timers["step 2"] += t_split.get();
+
+  // Run the tasks. Each task starts from a copy of the free graph matrices and
+  // accumulates the terms it generates in its own search object. Scratch
+  // space is allocated once per thread
+  ContractionSearch task_search{search.ops, search.factor, search.minrank,
+                                search.maxrank, search.linked_ops};
+  std::vector<ContractionSearch> task_searches(tasks.size(), task_search);
+  std::vector<BacktrackArena> arenas;
+  for (int thread = 0; thread < nthreads; thread++) {
+    arenas.emplace_back(max_depth, ncontr);
+  }
+  parallel_for(tasks.size(), nthreads, [&](int t, int thread) {
+    timer t_task;
+    const auto &[prefix, is_subtree] = tasks[t];
+    BacktrackArena &arena = arenas[thread];
+    std::vector<GraphMatrix> free_vec(free_graph_matrix_vec);
+    int k = prefix.size();
+    for (int i = 0; i < k; i++) {
+      make_move(arena.a, i + 1, prefix[i], el_contr_vec, free_vec);
+    }
+    if (is_subtree) {
+      generate_contractions_backtrack(k, el_contr_vec, free_vec, arena,
+                                      task_searches[t]);
+    } else {
+      process_contraction(arena.a, k, free_vec, task_searches[t]);
+    }
+    auto &task_timers = task_searches[t].timers;
+    task_timers["step 2"] += t_task.get() - task_timers["step 3"];
+  });
 
-  // test each candidate contraction
-  for (const auto &c : candidates) {
-    make_move(a, k, c, el_contr_vec, free_graph_matrix_vec);
-    generate_contractions_backtrack(a, k, el_contr_vec, free_graph_matrix_vec,
-                                    minrank, maxrank);
-    unmake_move(a, k, c, el_contr_vec, free_graph_matrix_vec);
+  // merge the results in the same order as the serial algorithm
+  for (const auto &task_search : task_searches) {
+    search.result += task_search.result;
+    search.ncontractions += task_search.ncontractions;
+    search.nnodes += task_search.nnodes;
+    search.npruned += task_search.npruned;
+    search.nleaves += task_search.nleaves;
+    for (const auto &[name, time] : task_search.timers) {
+      search.timers[name] += time;
+    }
   }
 }
 
 void WickTheorem::process_contraction(
     const std::vector<int> &a, int k,
-    const std::vector<GraphMatrix> &free_graph_matrix_vec, const int minrank,
-    const int maxrank) {
-  int num_ops = sum_num_ops(free_graph_matrix_vec);
-  if ((num_ops >= minrank) and (num_ops <= maxrank)) {
-    contractions_.push_back(std::vector<int>(a.begin(), a.begin() + k));
-    ncontractions_++;
+    const std::vector<GraphMatrix> &free_graph_matrix_vec,
+    ContractionSearch &search) {
+  if (is_kept(a, k, free_graph_matrix_vec, search)) {
+    search.ncontractions++;
     PRINT(
         PrintLevel::Summary, GraphMatrix free_ops;
         for (const auto &free_graph_matrix
              : free_graph_matrix_vec) { free_ops += free_graph_matrix; };
-        cout << fmt::format("\n  {:5d}    {:3d}    ", ncontractions_ + 1,
+        cout << fmt::format("\n  {:5d}    {:3d}    ", search.ncontractions,
                             free_ops.num_ops());
         for (int i = 0; i < k; ++i) { cout << fmt::format(" {:3d}", a[i]); };
         cout << std::string(std::max(24 - 4 * k, 2), ' ') << free_ops;)
+    add_contraction_term(a, k, search);
   }
 }
 
-std::vector<int> WickTheorem::construct_candidates(
-    std::vector<int> &a, int k,
-    const std::vector<ElementaryContraction> &el_contr_vec,
-    const std::vector<GraphMatrix> &free_graph_matrix_vec) {
+bool WickTheorem::is_kept(const std::vector<int> &a, int k,
+                          const std::vector<GraphMatrix> &free_graph_matrix_vec,
+                          const ContractionSearch &search) const {
+  int num_ops = sum_num_ops(free_graph_matrix_vec);
+  if ((num_ops < search.minrank) or (num_ops > search.maxrank)) {
+    return false;
+  }
+  std::array<std::uint64_t, 64> components;
+  if (connected_only_ and
+      (connected_components(a, k, free_graph_matrix_vec.size(), components) >
+       1)) {
+    return false;
+  }
+  if (search.linked_ops and not is_linked(a, k, search.linked_ops)) {
+    return false;
+  }
+  return true;
+}
 
-  std::vector<int> candidates;
-  int nops = free_graph_matrix_vec.size();
+bool WickTheorem::is_prunable(
+    const std::vector<int> &a, int k,
+    const std::vector<GraphMatrix> &free_graph_matrix_vec,
+    const ContractionSearch &search) const {
+  // adding contractions can only lower the number of free operators
+  int num_ops = sum_num_ops(free_graph_matrix_vec);
+  if (num_ops < search.minrank) {
+    return true;
+  }
+  if (num_ops <= search.maxrank) {
+    return false;
+  }
 
-  // determine the last elementary contraction used
-  // the -2 is here because k is incremented just before calling this function
-  int minc = (k > 1) ? a[k - 2] : 0;
-  int maxc = el_contr_vec.size();
-
-  // loop over all potentially viable contractions
-  for (int c = minc; c < maxc; c++) {
-    const auto &el_contr = el_contr_vec[c];
-
-    // test if this contraction is valid: check that the number of
-    // operators to contract is less than or equal to the number of
-    // free (uncontracted) operators
-    bool is_valid_contraction = true;
-    for (int A = 0; A < nops; A++) {
-      for (int s = 0; s < orbital_subspaces->num_spaces(); s++) {
-        if (free_graph_matrix_vec[A].cre(s) < el_contr[A].cre(s)) {
-          is_valid_contraction = false;
+  // Find an upper bound to the number of operators that can still be
+  // contracted. Elementary contractions are sorted by space and are added in
+  // increasing order, so only spaces starting from the one of the last
+  // contraction are available.
+  int first_space = (k > 0) ? elementary_contractions_space_[a[k - 1]] : 0;
+  int max_contracted = max_contracted_ops(free_graph_matrix_vec, first_space);
+  return num_ops - max_contracted > search.maxrank;
+}
+
+int WickTheorem::connected_components(
+    const std::vector<int> &a, int k, int nops,
+    std::array<std::uint64_t, 64> &components) const {
+  // start with each operator in its own component
+  int ncomponents = nops;
+  for (int A = 0; A < nops; A++) {
+    components[A] = std::uint64_t(1) << A;
+  }
+  // merge all the components touched by each contraction
+  for (int i = 0; i < k; i++) {
+    std::uint64_t mask = elementary_contractions_ops_[a[i]];
+    std::uint64_t merged = 0;
+    int n = 0;
+    for (int j = 0; j < ncomponents; j++) {
+      if (components[j] & mask) {
+        merged |= components[j];
+      } else {
+        components[n++] = components[j];
+      }
+    }
+    components[n++] = merged;
+    ncomponents = n;
+  }
+  return ncomponents;
+}
+
+bool WickTheorem::can_be_connected(const std::vector<int> &a, int k, int nops,
+                                   const std::vector<int> &candidates) const {
+  std::array<std::uint64_t, 64> components;
+  int ncomponents = connected_components(a, k, nops, components);
+  if (ncomponents <= 1) {
+    return true;
+  }
+  // every component must be linked to another one by at least one candidate.
+  // Candidates can only be removed as the search proceeds, so if this is not
+  // the case no contraction in this branch is connected
+  for (int i = 0; i < ncomponents; i++) {
+    std::uint64_t component = components[i];
+    bool linked = false;
+    for (int c : candidates) {
+      std::uint64_t mask = elementary_contractions_ops_[c];
+      if ((mask & component) and (mask & ~component)) {
+        linked = true;
+        break;
+      }
+    }
+    if (not linked) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WickTheorem::is_linked(const std::vector<int> &a, int k,
+                            std::uint64_t linked_ops) const {
+  for (int i = 0; i < k; i++) {
+    std::uint64_t mask = elementary_contractions_ops_[a[i]];
+    if ((mask & linked_ops) and (mask & ~linked_ops)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WickTheorem::can_be_linked(const std::vector<int> &a, int k,
+                                std::uint64_t linked_ops,
+                                const std::vector<int> &candidates) const {
+  if (is_linked(a, k, linked_ops)) {
+    return true;
+  }
+  for (int c : candidates) {
+    std::uint64_t mask = elementary_contractions_ops_[c];
+    if ((mask & linked_ops) and (mask & ~linked_ops)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Return the index of the lowest bit set in a nonzero word
+static int lowest_bit(std::uint64_t w) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(w);
+#else
+  int n = 0;
+  for (; (w & 1) == 0; w >>= 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+void WickTheorem::build_candidate_tables(const OperatorProduct &ops) {
+  int ncontr = elementary_contractions_.size();
+  candidate_words_ = (ncontr + 63) / 64;
+  candidate_legs_.clear();
+  candidate_table_.clear();
+
+  // loop over all legs that appear in at least one elementary contraction
+  int nops = ops.size();
+  for (int A = 0; A < nops; A++) {
+    for (int s = 0; s < orbital_subspaces->num_spaces(); s++) {
+      for (bool cre : {true, false}) {
+        auto legs = [&](const GraphMatrix &gm) {
+          return cre ? gm.cre(s) : gm.ann(s);
+        };
+        bool used = false;
+        for (const auto &el_contr : elementary_contractions_) {
+          used = used or (legs(el_contr[A]) > 0);
         }
-        if (free_graph_matrix_vec[A].ann(s) < el_contr[A].ann(s)) {
-          is_valid_contraction = false;
+        if (not used) {
+          continue;
+        }
+        int count = legs(ops[A].graph_matrix());
+        int offset = candidate_table_.size() / candidate_words_;
+        candidate_legs_.push_back({A, s, cre, count, offset});
+        // for n free operators mark the contractions that use at most n
+        candidate_table_.resize(candidate_table_.size() +
+                                (count + 1) * candidate_words_);
+        for (int n = 0; n <= count; n++) {
+          std::uint64_t *bits =
+              &candidate_table_[(offset + n) * candidate_words_];
+          for (int c = 0; c < ncontr; c++) {
+            if (legs(elementary_contractions_[c][A]) <= n) {
+              bits[c / 64] |= std::uint64_t(1) << (c % 64);
+            }
+          }
         }
       }
     }
-    if (is_valid_contraction) {
-      candidates.push_back(c);
+  }
+}
+
+void WickTheorem::construct_candidates(
+    const std::vector<int> &a, int k,
+    const std::vector<GraphMatrix> &free_graph_matrix_vec,
+    std::vector<std::uint64_t> &bits, std::vector<int> &candidates) const {
+  candidates.clear();
+
+  // determine the last elementary contraction used
+  // the -2 is here because k is incremented just before calling this function
+  int minc = (k > 1) ? a[k - 2] : 0;
+  int maxc = elementary_contractions_.size();
+  if (minc >= maxc) {
+    return;
+  }
+
+  // start from the set of contractions with index in the range [minc, maxc)
+  bits.assign(candidate_words_, ~std::uint64_t(0));
+  int first_word = minc / 64;
+  for (int w = 0; w < first_word; w++) {
+    bits[w] = 0;
+  }
+  bits[first_word] &= ~std::uint64_t(0) << (minc % 64);
+  if (maxc % 64 != 0) {
+    bits[candidate_words_ - 1] &= (std::uint64_t(1) << (maxc % 64)) - 1;
+  }
+
+  // a contraction is valid if the number of operators to contract is less
+  // than or equal to the number of free (uncontracted) operators. For each leg
+  // with some operators already contracted keep only the contractions
+  // compatible with the number of free operators
+  for (const auto &leg : candidate_legs_) {
+    const auto &free_gm = free_graph_matrix_vec[leg.op];
+    int n = leg.cre ? free_gm.cre(leg.space) : free_gm.ann(leg.space);
+    if (n == leg.count) {
+      continue;
+    }
+    const std::uint64_t *leg_bits =
+        &candidate_table_[(leg.offset + n) * candidate_words_];
+    for (int w = first_word; w < candidate_words_; w++) {
+      bits[w] &= leg_bits[w];
+    }
+  }
+
+  // collect the candidates in increasing order
+  for (int w = first_word; w < candidate_words_; w++) {
+    for (std::uint64_t word = bits[w]; word != 0; word &= word - 1) {
+      candidates.push_back(64 * w + lowest_bit(word));
     }
   }
-  return candidates;
 }
 
 void WickTheorem::make_move(
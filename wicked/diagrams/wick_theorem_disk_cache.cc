@@ -0,0 +1,245 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "fmt/format.h"
+
+#include "helpers/helpers.h"
+#include "helpers/orbital_space.h"
+
+#include "contraction.h"
+#include "operator.h"
+#include "operator_product.h"
+
+#include "../algebra/expression.h"
+#include "../algebra/sqoperator.h"
+#include "../algebra/tensor.h"
+#include "../algebra/tensor_symmetry.h"
+
+#include "wick_theorem.h"
+
+std::string contraction_signature(const OperatorProduct &ops,
+                                  const CompositeContraction &contractions,
+                                  const std::vector<int> &ops_perm,
+                                  const std::vector<int> &contr_perm);
+
+// Each file of the disk cache stores the key followed by the expression
+// serialized in a compact binary format:
+//
+//   magic | key | number of terms | term 1 | term 2 | ...
+//
+// Integers are stored as 32-bit values, strings as a length followed by the
+// characters, and the numerator and denominator of the coefficients as decimal
+// strings, so that the format does not depend on the integer type used by
+// rational. Changing the format requires changing the magic string.
+
+namespace {
+
+const std::string disk_cache_magic = "wicked-contraction-cache-1";
+
+/// A 64-bit FNV-1a hash used to name the files of the cache
+std::uint64_t fnv1a_hash(const std::string &s) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void write_int(std::ostream &os, std::int32_t n) {
+  os.write(reinterpret_cast<const char *>(&n), sizeof(n));
+}
+
+void write_string(std::ostream &os, const std::string &s) {
+  write_int(os, s.size());
+  os.write(s.data(), s.size());
+}
+
+void write_index(std::ostream &os, const Index &idx) {
+  write_int(os, idx.space());
+  write_int(os, idx.pos());
+}
+
+template <class T> std::string to_decimal(const T &n) {
+  std::ostringstream ss;
+  ss << n;
+  return ss.str();
+}
+
+void write_term(std::ostream &os, const SymbolicTerm &term,
+                const scalar_t &coefficient) {
+  write_int(os, term.normal_ordered());
+  write_int(os, term.tensors().size());
+  for (const auto &tensor : term.tensors()) {
+    write_string(os, tensor.label());
+    write_int(os, static_cast<int>(tensor.symmetry()));
+    write_int(os, tensor.lower().size());
+    for (const auto &idx : tensor.lower()) {
+      write_index(os, idx);
+    }
+    write_int(os, tensor.upper().size());
+    for (const auto &idx : tensor.upper()) {
+      write_index(os, idx);
+    }
+  }
+  write_int(os, term.ops().size());
+  for (const auto &op : term.ops()) {
+    write_int(os, static_cast<int>(op.type()));
+    write_index(os, op.index());
+  }
+  write_string(os, to_decimal(coefficient.numerator()));
+  write_string(os, to_decimal(coefficient.denominator()));
+}
+
+// The read functions throw if the stream ends before the data is read
+
+std::int32_t read_int(std::istream &is) {
+  std::int32_t n;
+  if (not is.read(reinterpret_cast<char *>(&n), sizeof(n))) {
+    throw std::runtime_error("read_int - unexpected end of file");
+  }
+  return n;
+}
+
+std::string read_string(std::istream &is) {
+  std::int32_t size = read_int(is);
+  if (size < 0) {
+    throw std::runtime_error("read_string - invalid string size");
+  }
+  std::string s(size, '\0');
+  if (not is.read(s.data(), size)) {
+    throw std::runtime_error("read_string - unexpected end of file");
+  }
+  return s;
+}
+
+Index read_index(std::istream &is) {
+  int space = read_int(is);
+  int pos = read_int(is);
+  return Index(space, pos);
+}
+
+std::vector<Index> read_indices(std::istream &is) {
+  std::vector<Index> indices(read_int(is));
+  for (auto &idx : indices) {
+    idx = read_index(is);
+  }
+  return indices;
+}
+
+rational_t from_decimal(const std::string &s) {
+  rational_t n;
+  std::istringstream ss(s);
+  if (not(ss >> n)) {
+    throw std::runtime_error("from_decimal - invalid integer");
+  }
+  return n;
+}
+
+std::pair<SymbolicTerm, scalar_t> read_term(std::istream &is) {
+  bool normal_ordered = read_int(is);
+  std::vector<Tensor> tensors(read_int(is));
+  for (auto &tensor : tensors) {
+    std::string label = read_string(is);
+    auto symmetry = static_cast<SymmetryType>(read_int(is));
+    std::vector<Index> lower = read_indices(is);
+    std::vector<Index> upper = read_indices(is);
+    tensor = Tensor(label, lower, upper, symmetry);
+  }
+  std::vector<SQOperator> ops;
+  for (int i = 0, nops = read_int(is); i < nops; i++) {
+    auto type = static_cast<SQOperatorType>(read_int(is));
+    ops.push_back(SQOperator(type, read_index(is)));
+  }
+  rational_t numerator = from_decimal(read_string(is));
+  rational_t denominator = from_decimal(read_string(is));
+  return std::make_pair(SymbolicTerm(normal_ordered, ops, tensors),
+                        scalar_t(numerator, denominator));
+}
+
+} // namespace
+
+std::string WickTheorem::disk_cache_key(const OperatorProduct &ops,
+                                        const int minrank, const int maxrank,
+                                        std::uint64_t linked_ops) const {
+  std::string key = orbital_subspaces->str() + tensor_symmetries_str();
+  key += '\0';
+  key += contraction_signature(ops, CompositeContraction(),
+                               iota_vector<int>(ops.size()), {});
+  key += '\0';
+  key += fmt::format("minrank={} maxrank={} maxcumulant={} linked_ops={} "
+                     "connected_only={} canonicalize_graph={}",
+                     minrank, maxrank, maxcumulant_, linked_ops,
+                     connected_only_, do_canonicalize_graph_);
+  return key;
+}
+
+bool WickTheorem::read_disk_cache(const std::string &key,
+                                  Expression &result) const {
+  const auto path = std::filesystem::path(disk_cache_path_) /
+                    fmt::format("{:016x}.bin", fnv1a_hash(key));
+  std::ifstream file(path, std::ios::binary);
+  if (not file) {
+    return false;
+  }
+  // A file that cannot be read (e.g., because it was written by a different
+  // version) or that stores a different key (hash collision) is a miss
+  try {
+    if ((read_string(file) != disk_cache_magic) or (read_string(file) != key)) {
+      return false;
+    }
+    Expression expr;
+    for (int i = 0, nterms = read_int(file); i < nterms; i++) {
+      expr.add(read_term(file));
+    }
+    result = expr;
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool WickTheorem::write_disk_cache(const std::string &key,
+                                   const Expression &result) const {
+  // Writing is best effort: a directory that cannot be written (e.g., because
+  // it is read-only or full) is not an error, and the temporary file is
+  // removed on any failure
+  std::error_code ec;
+  const auto dir = std::filesystem::path(disk_cache_path_);
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    return false;
+  }
+  const auto path = dir / fmt::format("{:016x}.bin", fnv1a_hash(key));
+
+  // The file is written under a unique temporary name and then renamed, which
+  // is atomic. Readers (also in other processes) never see a partial file
+  std::filesystem::path tmp_path;
+  bool written = false;
+  try {
+    std::random_device rd;
+    tmp_path = dir / fmt::format("{:016x}.{:08x}.tmp", fnv1a_hash(key), rd());
+    std::ofstream file(tmp_path, std::ios::binary);
+    write_string(file, disk_cache_magic);
+    write_string(file, key);
+    write_int(file, result.size());
+    for (const auto &[term, coefficient] : result.terms()) {
+      write_term(file, term, coefficient);
+    }
+    file.close();
+    written = static_cast<bool>(file);
+  } catch (const std::exception &) {
+    written = false;
+  }
+  if (written) {
+    std::filesystem::rename(tmp_path, path, ec);
+    written = not ec;
+  }
+  if ((not written) and (not tmp_path.empty())) {
+    std::filesystem::remove(tmp_path, ec);
+  }
+  return written;
+}
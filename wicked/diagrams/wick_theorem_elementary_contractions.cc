@@ -5,6 +5,7 @@
 #include "helpers/stl_utils.hpp"
 
 #include "contraction.h"
+#include "contraction_cache.h"
 #include "operator.h"
 #include "operator_product.h"
 
@@ -17,12 +18,45 @@
 
 using namespace std;
 
+namespace {
+/// The key used to store the elementary contractions of a product of
+/// operators in the cache. It stores each count of the graph matrices of the
+/// operators in one character followed by the largest cumulant
+std::string elementary_contractions_key(const OperatorProduct &ops,
+                                        int maxcumulant) {
+  const int nspaces = orbital_subspaces->num_spaces();
+  std::string s;
+  for (const auto &op : ops) {
+    for (int sp = 0; sp < nspaces; sp++) {
+      s += static_cast<char>(op.cre(sp));
+      s += static_cast<char>(op.ann(sp));
+    }
+  }
+  return s + std::to_string(maxcumulant);
+}
+} // namespace
+
 std::vector<ElementaryContraction>
 WickTheorem::generate_elementary_contractions(const OperatorProduct &ops) {
   PRINT(PrintLevel::Summary,
         std::cout << "\n- Step 1. Generating elementary contractions"
                   << std::endl;)
 
+  // The elementary contractions depend only on the graph matrices of the
+  // operators, so they are generated once for all the products with the same
+  // sequence of graph matrices. The cache is bypassed when printing
+  const bool use_cache = (print_ == PrintLevel::None);
+  std::string key;
+  if (use_cache) {
+    key = elementary_contractions_key(ops, maxcumulant_);
+    std::vector<ElementaryContraction> contr_vec;
+    const bool found = contraction_cache_->find_elementary(key, contr_vec);
+    timers_[found ? "elementary contraction cache hits"
+                  : "elementary contraction cache misses"] += 1;
+    if (found)
+      return contr_vec;
+  }
+
   int nops = ops.size();
 
   // a vector that will hold all the contractions
@@ -69,6 +103,9 @@ WickTheorem::generate_elementary_contractions(const OperatorProduct &ops) {
       elementary_contractions_general(ops, s, contr_vec);
     }
   }
+  if (use_cache) {
+    contraction_cache_->insert_elementary(key, contr_vec);
+  }
   return contr_vec;
 }
 
@@ -125,59 +162,52 @@ void WickTheorem::elementary_contractions_general(
   // operators and the maximum cumulant level allowed
   int max_half_legs = std::min(std::min(sumcre, sumann), maxcumulant_);
 
+  // the number of creation and annihilation operators of each operator
+  std::vector<int> cre_caps(nops), ann_caps(nops);
+  for (int A = 0; A < nops; A++) {
+    cre_caps[A] = ops[A].cre(s);
+    ann_caps[A] = ops[A].ann(s);
+  }
+
+  // if a vector of legs has all its legs on one operator, return the index of
+  // this operator, otherwise return -1
+  auto single_op = [&](const std::vector<int> &legs) {
+    int op = -1;
+    for (int A = 0; A < nops; A++) {
+      if (legs[A] > 0) {
+        if (op >= 0)
+          return -1;
+        op = A;
+      }
+    }
+    return op;
+  };
+
   // in this algorithm we loop over all possible lengths of half-leg
-  // contractions, partition this number into integers, permute these integers
-  // to generate elementary contractions, and test if these are valid
+  // contractions and generate the distributions of the legs among the
+  // operators that are compatible with the number of creation and
+  // annihilation operators
   for (int half_legs = 1; half_legs <= max_half_legs; half_legs++) {
     PRINT(PrintLevel::Summary,
           cout << "\n    " << 2 * half_legs << "-legs contractions";)
-    // create partitions of the number of half legs into at most nops numbers.
-    // For half_legs = 2 and nops = 2, half_legs_part = [[2],[1,1]]
-    auto half_legs_part = integer_partitions(half_legs, nops);
-    // create lists of leg partitionings among all operators that are
-    // compatible with the number of creation and annihilation operators
-    //
     // these vectors store the number of cre/ann operators contracted per
-    // operator
-    std::vector<std::vector<int>> cre_legs_vec, ann_legs_vec;
-    for (const auto part : half_legs_part) {
-      // here we copy the partition and permute it (with added zeros, which
-      // signify no contraction)
-      std::vector<int> perm(nops, 0);
-      std::copy(part.begin(), part.end(), perm.begin());
-      std::sort(perm.begin(), perm.end());
-      do {
-        // check if compatible with creation/annihilation operators
-        bool cre_compatible = true;
-        bool ann_compatible = true;
-        for (int A = 0; A < nops; A++) {
-          if (ops[A].cre(s) < perm[A]) {
-            cre_compatible = false;
-          }
-          if (ops[A].ann(s) < perm[A]) {
-            ann_compatible = false;
-          }
-        }
-        if (cre_compatible) {
-          cre_legs_vec.push_back(perm);
-        }
-        if (ann_compatible) {
-          ann_legs_vec.push_back(perm);
-        }
-      } while (std::next_permutation(perm.begin(), perm.end()));
+    // operator. For half_legs = 2 and two operators with two creation
+    // operators each, cre_legs_vec = [[0, 2], [1, 1], [2, 0]]
+    const auto cre_legs_vec = bounded_compositions(half_legs, cre_caps);
+    const auto ann_legs_vec = bounded_compositions(half_legs, ann_caps);
+    std::vector<int> ann_single_op(ann_legs_vec.size());
+    for (size_t j = 0; j < ann_legs_vec.size(); j++) {
+      ann_single_op[j] = single_op(ann_legs_vec[j]);
     }
 
     // combine the creation and annihilation operators
-    for (const auto cre_legs : cre_legs_vec) {
-      for (const auto ann_legs : ann_legs_vec) {
-        // count number of operators contracted
-        int nops_contracted = 0;
-        for (int A = 0; A < nops; A++) {
-          nops_contracted += (cre_legs[A] + ann_legs[A] > 0);
-        }
-        // exclude operators that have legs only on one operator
-        if (nops_contracted < 2)
+    for (const auto &cre_legs : cre_legs_vec) {
+      const int cre_single_op = single_op(cre_legs);
+      for (size_t j = 0; j < ann_legs_vec.size(); j++) {
+        // exclude contractions that have legs only on one operator
+        if ((cre_single_op >= 0) and (cre_single_op == ann_single_op[j]))
           continue;
+        const auto &ann_legs = ann_legs_vec[j];
         // for a vector of GraphMatrix objects that represent this
         // contraction
         std::vector<GraphMatrix> new_contr(nops);
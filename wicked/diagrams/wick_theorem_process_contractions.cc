@@ -11,6 +11,7 @@
 #include "helpers/timer.hpp"
 
 #include "contraction.h"
+#include "contraction_cache.h"
 #include "operator.h"
 #include "operator_expression.h"
 
@@ -43,86 +44,147 @@ std::string contraction_signature(const OperatorProduct &ops,
                                   const std::vector<int> &ops_perm,
                                   const std::vector<int> &contr_perm);
 
-using namespace std;
-
-Expression WickTheorem::process_contractions(scalar_t factor,
-                                             const OperatorProduct &ops,
-                                             const int minrank,
-                                             const int maxrank) {
-  PRINT(PrintLevel::Summary,
-        std::cout << "\n- Step 3. Processing contractions" << std::endl;)
-
-  Expression result;
-
-  // loop over all contractions and keep those with the correct rank
-  // contraction_vec stores a list of elementary contractions appearing
-  // in a term
-  int nprocessed = 0;
-  int ops_rank = ops.num_ops();
-  for (const auto &contraction_vec : contractions_) {
-    int contr_rank = 0;
-    for (int c : contraction_vec) {
-      contr_rank += elementary_contractions_[c].num_ops();
-    }
-    int term_rank = ops_rank - contr_rank;
+std::pair<OperatorProduct, CompositeContraction>
+permute_contraction_graph(const OperatorProduct &ops,
+                          const CompositeContraction &contractions,
+                          const std::vector<int> &ops_perm,
+                          const std::vector<int> &contr_perm);
 
-    if ((term_rank >= minrank) and (term_rank <= maxrank)) {
-      nprocessed++;
-      PRINT(PrintLevel::Basic,
-            cout << "\n\n  Contraction: " << nprocessed
-                 << "  Operator rank: " << ops_rank - contr_rank << endl;)
+using namespace std;
 
-      CompositeContraction contraction;
-      for (int c : contraction_vec) {
-        contraction.push_back(elementary_contractions_[c]);
-      }
+void WickTheorem::add_contraction_term(const std::vector<int> &a, int k,
+                                       ContractionSearch &search) {
+  timer t3;
+  const OperatorProduct &ops = search.ops;
+
+  // a stores a list of elementary contractions appearing in a term
+  CompositeContraction contraction;
+  int contr_rank = 0;
+  for (int i = 0; i < k; i++) {
+    contraction.push_back(elementary_contractions_[a[i]]);
+    contr_rank += elementary_contractions_[a[i]].num_ops();
+  }
+  PRINT(PrintLevel::Basic,
+        cout << "\n\n  Contraction: " << search.ncontractions
+             << "  Operator rank: " << ops.num_ops() - contr_rank << endl;)
+
+  // Equivalent contractions have the same canonical graph, so the result of
+  // evaluating a canonical graph can be stored in a cache. The canonical form
+  // of each graph is cached too, so that a contraction seen before is neither
+  // canonicalized nor evaluated. The cache is bypassed when printing so that
+  // the details of all contractions are shown
+  const bool use_cache =
+      use_contraction_cache_ and (print_ == PrintLevel::None);
+  CachedCanonicalGraph graph;
+  bool found_graph = false;
+  std::string graph_key;
+  if (use_cache and do_canonicalize_graph_) {
+    graph_key = contraction_signature(ops, contraction,
+                                      iota_vector<int>(ops.size()),
+                                      iota_vector<int>(contraction.size()));
+    found_graph = contraction_cache_->find_graph(graph_key, graph);
+    search.timers[found_graph ? "contraction graph cache hits"
+                              : "contraction graph cache misses"] += 1;
+  }
 
-      timer tc;
-      const auto [best_ops, best_contractions, sign] =
-          do_canonicalize_graph_
-              ? canonicalize_contraction_graph(ops, contraction)
-              : std::make_tuple(ops, contraction, scalar_t(1));
-      timers_["canonicalize_contraction_graph"] += tc.get();
-
-      timer te;
-      std::pair<SymbolicTerm, scalar_t> term_factor =
-          evaluate_contraction(best_ops, best_contractions, factor * sign);
-      timers_["evaluate_contraction"] += te.get();
-
-      SymbolicTerm &term = term_factor.first;
-      scalar_t canonicalize_factor = term.canonicalize();
-      result.add(
-          std::make_pair(term, term_factor.second * canonicalize_factor));
-
-      PRINT(PrintLevel::Summary,
-            Term t(term_factor.second * canonicalize_factor, term);
-            cout << "\n    term: " << t << endl;)
+  timer tc;
+  if (not found_graph) {
+    if (do_canonicalize_graph_) {
+      std::tie(graph.ops_perm, graph.contr_perm, graph.sign) =
+          canonical_contraction_graph_order(ops, contraction);
+    } else {
+      graph.ops_perm = iota_vector<int>(ops.size());
+      graph.contr_perm = iota_vector<int>(contraction.size());
+      graph.sign = scalar_t(1);
     }
   }
-  if (nprocessed == 0) {
-    PRINT(PrintLevel::Summary, std::cout << "\n  No contractions generated\n"
-                                         << std::endl;)
+  OperatorProduct best_ops;
+  CompositeContraction best_contractions;
+  auto permute = [&]() {
+    std::tie(best_ops, best_contractions) = permute_contraction_graph(
+        ops, contraction, graph.ops_perm, graph.contr_perm);
+  };
+  if (use_cache and not found_graph) {
+    permute();
+    graph.key = contraction_signature(
+        best_ops, best_contractions, iota_vector<int>(best_ops.size()),
+        iota_vector<int>(best_contractions.size()));
+    if (do_canonicalize_graph_) {
+      contraction_cache_->insert_graph(graph_key, graph);
+    }
   }
-  return result;
+  search.timers["canonicalize_contraction_graph"] += tc.get();
+
+  CachedContraction cached;
+  bool found = false;
+  if (use_cache) {
+    found = contraction_cache_->find(graph.key, cached);
+    search.timers[found ? "contraction cache hits"
+                        : "contraction cache misses"] += 1;
+  }
+
+  if (not found) {
+    // a graph found in the cache is permuted only if it must be evaluated
+    if (found_graph or not use_cache) {
+      permute();
+    }
+    // the term is evaluated for a unit factor and sign so that it can be
+    // reused
+    timer te;
+    std::pair<SymbolicTerm, scalar_t> term_factor =
+        evaluate_contraction(best_ops, best_contractions, scalar_t(1));
+    search.timers["evaluate_contraction"] += te.get();
+
+    cached.term = term_factor.first;
+    cached.factor = term_factor.second * cached.term.canonicalize();
+    if (use_cache) {
+      contraction_cache_->insert(graph.key, cached);
+    }
+  }
+
+  const scalar_t sign = graph.sign;
+  const scalar_t factor = search.factor * sign * cached.factor;
+  search.result.add(std::make_pair(cached.term, factor));
+
+  PRINT(PrintLevel::Summary, Term t(factor, cached.term);
+        cout << "\n    term: " << t << endl;)
+  search.timers["step 3"] += t3.get();
 }
 
 std::string contraction_signature(const OperatorProduct &ops,
                                   const CompositeContraction &contractions,
                                   const std::vector<int> &ops_perm,
                                   const std::vector<int> &contr_perm) {
+  // The signature stores each count of a graph matrix in one character. The
+  // labels and factors of the operators are terminated by a null character,
+  // so that two different graphs never have the same signature
+  const int nspaces = orbital_subspaces->num_spaces();
+  auto add_graph_matrix = [&](std::string &s, const GraphMatrix &gm) {
+    for (int sp = 0; sp < nspaces; sp++) {
+      s += static_cast<char>(gm.cre(sp));
+      s += static_cast<char>(gm.ann(sp));
+    }
+  };
 
+  // 1. Add the operators
   std::string s;
   int nops = ops.size();
   for (int i = 0; i < nops; i++) {
-    s += ops[ops_perm[i]].label();
-    s += signature(ops[ops_perm[i]].graph_matrix());
+    const auto &op = ops[ops_perm[i]];
+    s += op.label();
+    s += '\0';
+    if (op.factor() != scalar_t(1)) {
+      s += op.factor().repr();
+    }
+    s += '\0';
+    add_graph_matrix(s, op.graph_matrix());
   }
 
-  // 2. Compare contractions
+  // 2. Add the contractions
   int ncontr = contractions.size();
   for (int i = 0; i < ncontr; i++) {
     for (int j = 0; j < nops; j++) {
-      s += signature(contractions[contr_perm[i]][ops_perm[j]]);
+      add_graph_matrix(s, contractions[contr_perm[i]][ops_perm[j]]);
     }
   }
   return s;
@@ -134,19 +196,8 @@ WickTheorem::evaluate_contraction(const OperatorProduct &ops,
                                   scalar_t factor) {
   // 1. Get the Tensor objects and SQOperator vector corresponding to the
   // uncontracted term
-  auto tensors_sqops_op_map = contraction_tensors_sqops(ops);
-  std::vector<Tensor> &tensors = std::get<0>(tensors_sqops_op_map);
-  std::vector<SQOperator> &sqops = std::get<1>(tensors_sqops_op_map);
-
-  // this map takes the operator index (op), orbital space (s), the sqop type
-  // (true = cre, false = ann), and an index and maps it to the operators as
-  // they are stored in a vector:
-  //
-  //  std::map<std::tuple<int, int, bool, int>, int> op_map;
-  //                       op space cre    n
-  //
-  std::map<std::tuple<int, int, bool, int>, int> &op_map =
-      std::get<2>(tensors_sqops_op_map);
+  auto [tensors, sqops, sqop_pos] = contraction_tensors_sqops(ops);
+  tensors.reserve(tensors.size() + contractions.size());
 
   // 2. Apply the contractions to the second quantized operators and add new
   // tensors (density matrices, cumulants)
@@ -182,10 +233,10 @@ WickTheorem::evaluate_contraction(const OperatorProduct &ops,
 
     // find the position of the creation operators
     std::vector<int> pos_cre_sqops =
-        elements_vec_to_pos(contraction, ops_offset, op_map, true);
+        elements_vec_to_pos(ops, contraction, ops_offset, sqop_pos, true);
     // find the position of the annihilation operators
     std::vector<int> pos_ann_sqops =
-        elements_vec_to_pos(contraction, ops_offset, op_map, false);
+        elements_vec_to_pos(ops, contraction, ops_offset, sqop_pos, false);
 
     // mark the creation operators contracted and their order
     for (int c : pos_cre_sqops) {
@@ -333,15 +384,23 @@ WickTheorem::evaluate_contraction(const OperatorProduct &ops,
   return std::make_pair(term, sign * factor * comb_factor);
 }
 
-std::tuple<std::vector<Tensor>, std::vector<SQOperator>,
-           std::map<std::tuple<int, int, bool, int>, int>>
+std::tuple<std::vector<Tensor>, std::vector<SQOperator>, std::vector<int>>
 WickTheorem::contraction_tensors_sqops(const OperatorProduct &ops) {
+  const int nspaces = orbital_subspaces->num_spaces();
 
   std::vector<SQOperator> sqops;
   std::vector<Tensor> tensors;
-  std::map<std::tuple<int, int, bool, int>, int> op_map;
+  sqops.reserve(ops.num_ops());
+  tensors.reserve(ops.size());
+
+  // this table stores the position in sqops of the first creation
+  // (annihilation) operator of the operator o in the space s at
+  // sqop_pos[2 * (o * nspaces + s)] (sqop_pos[2 * (o * nspaces + s) + 1]).
+  // The following creation (annihilation) operators are found at increasing
+  // (decreasing) positions
+  std::vector<int> sqop_pos(2 * ops.size() * nspaces);
 
-  index_counter ic(orbital_subspaces->num_spaces());
+  index_counter ic(nspaces);
 
   // Loop over all operators
   int n = 0;
@@ -349,14 +408,13 @@ WickTheorem::contraction_tensors_sqops(const OperatorProduct &ops) {
     const auto &op = ops[o];
     // Loop over creation operators (lower indices)
     std::vector<Index> lower;
-    for (int s = 0; s < orbital_subspaces->num_spaces(); s++) {
+    for (int s = 0; s < nspaces; s++) {
+      sqop_pos[2 * (o * nspaces + s)] = n;
       for (int c = 0; c < op.cre(s); c++) {
         Index idx(s, ic.next_index(s)); // get next available index
         sqops.push_back(SQOperator(SQOperatorType::Creation, idx));
         lower.push_back(idx);
-        auto key = std::make_tuple(o, s, true, c);
-        op_map[key] = n;
-        PRINT(PrintLevel::All, print_key(key, n););
+        PRINT(PrintLevel::All, print_key(std::make_tuple(o, s, true, c), n););
         n += 1;
       }
     }
@@ -365,14 +423,14 @@ WickTheorem::contraction_tensors_sqops(const OperatorProduct &ops) {
     // the annihilation operators are layed out in a reversed order (hence the
     // need to reverse the upper indices of the tensor, see below)
     std::vector<Index> upper;
-    for (int s = orbital_subspaces->num_spaces() - 1; s >= 0; s--) {
+    for (int s = nspaces - 1; s >= 0; s--) {
+      sqop_pos[2 * (o * nspaces + s) + 1] = n + op.ann(s) - 1;
       for (int a = op.ann(s) - 1; a >= 0; a--) {
         Index idx(s, ic.next_index(s)); // get next available index
         sqops.push_back(SQOperator(SQOperatorType::Annihilation, idx));
         upper.push_back(idx);
-        auto key = std::make_tuple(o, s, false, a);
-        op_map[key] = n;
-        PRINT(PrintLevel::All, print_key(key, n););
+        PRINT(PrintLevel::All,
+              print_key(std::make_tuple(o, s, false, a), n););
         n += 1;
       }
     }
@@ -382,13 +440,14 @@ WickTheorem::contraction_tensors_sqops(const OperatorProduct &ops) {
     tensors.push_back(
         Tensor(op.label(), lower, upper, SymmetryType::Antisymmetric));
   }
-  return make_tuple(tensors, sqops, op_map);
+  return make_tuple(tensors, sqops, sqop_pos);
 }
 
 std::vector<int> WickTheorem::elements_vec_to_pos(
-    const ElementaryContraction &elements_vec,
-    std::vector<GraphMatrix> &ops_offset,
-    std::map<std::tuple<int, int, bool, int>, int> &op_map, bool creation) {
+    const OperatorProduct &ops, const ElementaryContraction &elements_vec,
+    std::vector<GraphMatrix> &ops_offset, const std::vector<int> &sqop_pos,
+    bool creation) {
+  const int nspaces = orbital_subspaces->num_spaces();
 
   std::vector<int> result;
 
@@ -402,22 +461,18 @@ std::vector<int> WickTheorem::elements_vec_to_pos(
     int nops = creation ? graph_matrix.cre(s) : graph_matrix.ann(s);
     // assign the operator indices
     int ops_off = creation ? ops_offset[v].cre(s) : ops_offset[v].ann(s);
+    if (ops_off + nops > (creation ? ops[v].cre(s) : ops[v].ann(s))) {
+      throw std::runtime_error("WickTheorem::elements_vec_to_pos - the "
+                               "contraction has more legs than the operator");
+    }
+    // find the operators corresponding to the legs (starting from the
+    // leftmost operator)
+    const int first = sqop_pos[2 * (v * nspaces + s) + (creation ? 0 : 1)];
     for (int i = 0; i < nops; i++) {
-      // find the operator corresponding to this leg
-      auto key =
-          creation
-              ? std::make_tuple(v, s, true,
-                                ops_off + i) // start from the leftmost operator
-              : std::make_tuple(v, s, false, ops_off + i);
-      if (op_map.count(key) == 0) {
-        PRINT(PrintLevel::All, print_key(key, -1););
-        cout << " NOT FOUND!!!" << endl;
-        exit(1);
-      } else {
-        int sqop_pos = op_map[key];
-        result.push_back(sqop_pos);
-        PRINT(PrintLevel::All, print_key(key, sqop_pos););
-      }
+      const int pos = creation ? first + ops_off + i : first - ops_off - i;
+      result.push_back(pos);
+      PRINT(PrintLevel::All,
+            print_key(std::make_tuple(v, s, creation, ops_off + i), pos););
     }
     // update the creator's offset
     if (creation) {
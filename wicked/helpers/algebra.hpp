@@ -3,13 +3,19 @@
 
 #include <vector>
 
+#include "helpers/hashed_map.hpp"
 #include "helpers/helpers.h"
 
-/// Represents a vector space of objects of type T over the field F
+/// Represents a vector space of objects of type T over the field F.
+///
+/// The elements are stored in a hash table (see HashedMap), so T must provide
+/// a member function std::uint64_t hash() const. Iterating over the elements
+/// with begin()/end() or terms() visits them sorted by T::operator<, so the
+/// output does not depend on the order in which the elements were added.
 template <class T, class F> class Algebra {
 
 public:
-  using vecspace_t = std::map<T, F>;
+  using vecspace_t = HashedMap<T, F>;
   Algebra() {}
   Algebra(const vecspace_t &v) : terms_(v) {}
 
@@ -29,14 +35,21 @@ public:
 
   /// addition assignment
   Algebra &operator+=(const Algebra &rhs) {
-    for (const auto &[e, c] : rhs.terms()) {
+    if (&rhs == this) {
+      return *this *= scalar_t(2);
+    }
+    for (const auto &[e, c] : rhs.terms_.unsorted()) {
       add(e, c);
     }
     return *this;
   }
   /// subtraction assignment
   Algebra &operator-=(const Algebra &rhs) {
-    for (const auto &[e, c] : rhs.terms()) {
+    if (&rhs == this) {
+      terms_.clear();
+      return *this;
+    }
+    for (const auto &[e, c] : rhs.terms_.unsorted()) {
       add(e, -c);
     }
     return *this;
@@ -44,8 +57,8 @@ public:
   /// multiplication assignment (scalar)
   Algebra &operator*=(const Algebra &rhs) {
     Algebra result;
-    for (const auto &[e, c] : terms()) {
-      for (const auto &[er, cr] : rhs.terms()) {
+    for (const auto &[e, c] : terms_.unsorted()) {
+      for (const auto &[er, cr] : rhs.terms_.unsorted()) {
         result.add(e * er, c * cr);
       }
     }
@@ -54,14 +67,14 @@ public:
   }
   /// multiplication assignment (scalar)
   Algebra &operator*=(scalar_t factor) {
-    for (auto &[e, c] : terms()) {
+    for (auto &[e, c] : terms_.unsorted()) {
       c *= factor;
     }
     return *this;
   }
   /// division assignment (scalar)
   Algebra &operator/=(scalar_t factor) {
-    for (auto &[e, c] : terms()) {
+    for (auto &[e, c] : terms_.unsorted()) {
       c /= factor;
     }
     return *this;
@@ -76,4 +89,4 @@ protected:
   vecspace_t terms_;
 };
 
-#endif // _wicked_vector_space_h_
\ No newline at end of file
+#endif // _wicked_vector_space_h_
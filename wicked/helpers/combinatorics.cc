@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "combinatorics.h"
 
 long long int factorial(int n) {
@@ -89,3 +91,40 @@ std::vector<std::vector<int>> integer_partitions(int n, int maxlen) {
   }
   return partitions;
 }
+
+namespace {
+/// Add the compositions of n into the parts i, i + 1, ... to compositions.
+/// max_rest[i] is the largest sum of the parts i, i + 1, ...
+void add_bounded_compositions(int n, int i, const std::vector<int> &caps,
+                              const std::vector<int> &max_rest,
+                              std::vector<int> &composition,
+                              std::vector<std::vector<int>> &compositions) {
+  if (i == static_cast<int>(caps.size())) {
+    compositions.push_back(composition);
+    return;
+  }
+  // the parts after this one can add up to at most max_rest[i + 1]
+  for (int p = std::max(0, n - max_rest[i + 1]), maxp = std::min(caps[i], n);
+       p <= maxp; p++) {
+    composition[i] = p;
+    add_bounded_compositions(n - p, i + 1, caps, max_rest, composition,
+                             compositions);
+  }
+  composition[i] = 0;
+}
+} // namespace
+
+std::vector<std::vector<int>>
+bounded_compositions(int n, const std::vector<int> &caps) {
+  std::vector<std::vector<int>> compositions;
+  const int k = caps.size();
+  std::vector<int> max_rest(k + 1, 0);
+  for (int i = k - 1; i >= 0; i--) {
+    max_rest[i] = max_rest[i + 1] + std::max(caps[i], 0);
+  }
+  if ((n < 0) or (n > max_rest[0]))
+    return compositions;
+  std::vector<int> composition(k, 0);
+  add_bounded_compositions(n, 0, caps, max_rest, composition, compositions);
+  return compositions;
+}
@@ -14,6 +14,14 @@ long long int binomial(int n, int k);
 /// [[1, 1, 1, 1], [2, 1, 1], [2, 2], [3, 1], [4]]
 std::vector<std::vector<int>> integer_partitions(int n, int maxlen = 1024);
 
+/// Generate all the ways to write the integer n as a sum of caps.size()
+/// non-negative integers, the i-th of which is at most caps[i]. The
+/// compositions are generated in lexicographical order.
+/// For example, for n = 2 and caps = [1, 2] this code generates
+/// [[0, 2], [1, 1]]
+std::vector<std::vector<int>> bounded_compositions(int n,
+                                                   const std::vector<int> &caps);
+
 // Computes the sign of a permutation of integers
 int permutation_sign(const std::vector<int> &vec);
 
@@ -0,0 +1,315 @@
+#ifndef _wicked_hashed_map_h_
+#define _wicked_hashed_map_h_
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+/// A map from keys of type K to values of type V stored in a hash table with
+/// open addressing (linear probing). The keys must provide a member function
+/// std::uint64_t hash() const and the operators == and <.
+///
+/// The hash of a key is computed once, when the key is inserted, and keys are
+/// compared with == only when their hashes are equal. The elements are stored
+/// in a vector and are sorted by key only when they are iterated over with
+/// begin()/end(), so that the iteration order is the same as that of a
+/// std::map. Use unsorted() to access the elements when the order does not
+/// matter.
+///
+/// The non-const begin() sorts the elements in place, so it invalidates the
+/// iterators returned by find(). The const begin() never modifies the map: if
+/// the elements are not sorted it iterates over a sorted list of their
+/// positions, so several threads can read a const map at the same time.
+template <class K, class V> class HashedMap {
+public:
+  using value_type = std::pair<K, V>;
+  using iterator = typename std::vector<value_type>::iterator;
+
+  /// An iterator over the elements of a const map, either in the order in
+  /// which they are stored or in the order given by a list of positions
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename HashedMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+
+    const_iterator() = default;
+    const_iterator(const value_type *data,
+                   std::shared_ptr<const std::vector<size_t>> order, size_t pos)
+        : data_(data), order_(std::move(order)), pos_(pos) {}
+
+    reference operator*() const {
+      return order_ ? data_[(*order_)[pos_]] : data_[pos_];
+    }
+    pointer operator->() const { return &**this; }
+    const_iterator &operator++() {
+      ++pos_;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      ++pos_;
+      return it;
+    }
+    /// Iterators are compared by position, so the iterator returned by find()
+    /// may only be compared with end()
+    bool operator==(const const_iterator &other) const {
+      return pos_ == other.pos_;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return pos_ != other.pos_;
+    }
+
+  private:
+    const value_type *data_ = nullptr;
+    std::shared_ptr<const std::vector<size_t>> order_;
+    size_t pos_ = 0;
+  };
+
+  /// Return the number of elements
+  size_t size() const { return entries_.size(); }
+
+  /// Return true if there are no elements
+  bool empty() const { return entries_.empty(); }
+
+  /// Remove all the elements
+  void clear() {
+    entries_.clear();
+    hashes_.clear();
+    slots_.clear();
+    sorted_ = true;
+  }
+
+  /// Find an element. Returns end() if the key is not found
+  iterator find(const K &key) {
+    const size_t slot = find_slot(key, key.hash());
+    return (slot == npos) ? entries_.end()
+                          : entries_.begin() + (slots_[slot] - 1);
+  }
+
+  /// Find an element. Returns end() if the key is not found
+  const_iterator find(const K &key) const {
+    const size_t slot = find_slot(key, key.hash());
+    return const_iterator(entries_.data(), nullptr,
+                          (slot == npos) ? entries_.size() : slots_[slot] - 1);
+  }
+
+  /// Return a reference to the value of a key, which is inserted if not found
+  V &operator[](const K &key) {
+    const std::uint64_t hash = key.hash();
+    const size_t slot = find_slot(key, hash);
+    if (slot != npos) {
+      return entries_[slots_[slot] - 1].second;
+    }
+    return insert(key, V(), hash);
+  }
+
+  /// Add a value to the one of a key (inserting the key if not found). If the
+  /// result is zero the element is removed
+  void add(const K &key, const V &value) {
+    const std::uint64_t hash = key.hash();
+    const size_t slot = find_slot(key, hash);
+    if (slot == npos) {
+      insert(key, value, hash);
+      return;
+    }
+    V &v = entries_[slots_[slot] - 1].second;
+    v += value;
+    if (v == 0) {
+      erase_slot(slot);
+    }
+  }
+
+  /// Remove an element
+  void erase(iterator it) {
+    const size_t n = it - entries_.begin();
+    erase_slot(find_slot(entries_[n].first, hashes_[n]));
+  }
+
+  /// Iterate over the elements sorted by key
+  iterator begin() {
+    sort();
+    return entries_.begin();
+  }
+  const_iterator begin() const {
+    if (sorted_)
+      return const_iterator(entries_.data(), nullptr, 0);
+    return const_iterator(entries_.data(), sorted_order(), 0);
+  }
+  iterator end() { return entries_.end(); }
+  const_iterator end() const {
+    return const_iterator(entries_.data(), nullptr, entries_.size());
+  }
+
+  /// Return the elements in the order in which they are stored
+  const std::vector<value_type> &unsorted() const { return entries_; }
+
+  /// Return the elements in the order in which they are stored. The keys must
+  /// not be modified
+  std::vector<value_type> &unsorted() { return entries_; }
+
+  /// Two maps are equal if they contain the same elements
+  bool operator==(const HashedMap &other) const {
+    if (size() != other.size())
+      return false;
+    for (size_t n = 0; n < entries_.size(); n++) {
+      const size_t slot = other.find_slot(entries_[n].first, hashes_[n]);
+      if ((slot == npos) or
+          (not(other.entries_[other.slots_[slot] - 1].second ==
+               entries_[n].second)))
+        return false;
+    }
+    return true;
+  }
+
+  bool operator!=(const HashedMap &other) const { return not(*this == other); }
+
+private:
+  static constexpr size_t npos = ~size_t(0);
+
+  /// the elements and the hashes of their keys
+  std::vector<value_type> entries_;
+  std::vector<std::uint64_t> hashes_;
+  /// the hash table. Each slot stores the position of an element plus one (0
+  /// for empty slots). The number of slots is a power of two
+  std::vector<std::uint32_t> slots_;
+  /// are the elements sorted?
+  bool sorted_ = true;
+
+  /// The home slot of a hash. The bits of the hash are mixed (with the
+  /// finalizer of splitmix64) since only the lowest ones are used
+  size_t home_slot(std::uint64_t hash) const {
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    hash = hash ^ (hash >> 31);
+    return hash & (slots_.size() - 1);
+  }
+
+  /// Return the slot of a key or npos if the key is not found
+  size_t find_slot(const K &key, std::uint64_t hash) const {
+    if (slots_.empty())
+      return npos;
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = home_slot(hash); slots_[slot] != 0;
+         slot = (slot + 1) & mask) {
+      const size_t n = slots_[slot] - 1;
+      if ((hashes_[n] == hash) and (entries_[n].first == key))
+        return slot;
+    }
+    return npos;
+  }
+
+  /// Insert a new element and return a reference to its value
+  V &insert(const K &key, const V &value, std::uint64_t hash) {
+    // keep the load factor below 1/2
+    if (2 * (entries_.size() + 1) > slots_.size()) {
+      rehash(std::max<size_t>(16, 2 * slots_.size()));
+    }
+    const size_t mask = slots_.size() - 1;
+    size_t slot = home_slot(hash);
+    while (slots_[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    entries_.emplace_back(key, value);
+    hashes_.push_back(hash);
+    slots_[slot] = entries_.size();
+    sorted_ = sorted_ and (entries_.size() == 1);
+    return entries_.back().second;
+  }
+
+  /// Remove the element stored in a slot
+  void erase_slot(size_t slot) {
+    const size_t n = slots_[slot] - 1;
+    const size_t mask = slots_.size() - 1;
+
+    // empty the slot and move back the elements that follow it, so that
+    // they can still be reached from their home slot
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; slots_[next] != 0;
+         next = (next + 1) & mask) {
+      const size_t home = home_slot(hashes_[slots_[next] - 1]);
+      // move the element unless its home slot is in (hole, next]
+      const bool in_range = (hole <= next) ? ((hole < home) and (home <= next))
+                                           : ((hole < home) or (home <= next));
+      if (not in_range) {
+        slots_[hole] = slots_[next];
+        hole = next;
+      }
+    }
+    slots_[hole] = 0;
+
+    // move the last element in place of the one removed
+    const size_t last = entries_.size() - 1;
+    if (n != last) {
+      size_t last_slot = home_slot(hashes_[last]);
+      while (slots_[last_slot] != last + 1) {
+        last_slot = (last_slot + 1) & mask;
+      }
+      slots_[last_slot] = n + 1;
+      entries_[n] = std::move(entries_[last]);
+      hashes_[n] = hashes_[last];
+      sorted_ = false;
+    }
+    entries_.pop_back();
+    hashes_.pop_back();
+  }
+
+  /// Rebuild the hash table with a given number of slots
+  void rehash(size_t nslots) {
+    slots_.assign(nslots, 0);
+    const size_t mask = nslots - 1;
+    for (size_t n = 0; n < entries_.size(); n++) {
+      size_t slot = home_slot(hashes_[n]);
+      while (slots_[slot] != 0) {
+        slot = (slot + 1) & mask;
+      }
+      slots_[slot] = n + 1;
+    }
+  }
+
+  /// Return the positions of the elements sorted by key
+  std::shared_ptr<std::vector<size_t>> sorted_order() const {
+    auto order = std::make_shared<std::vector<size_t>>(entries_.size());
+    std::iota(order->begin(), order->end(), 0);
+    std::sort(order->begin(), order->end(), [&](size_t a, size_t b) {
+      return entries_[a].first < entries_[b].first;
+    });
+    return order;
+  }
+
+  /// Sort the elements by key
+  void sort() {
+    if (sorted_)
+      return;
+    const auto order = sorted_order();
+    std::vector<value_type> entries;
+    std::vector<std::uint64_t> hashes;
+    entries.reserve(entries_.size());
+    hashes.reserve(entries_.size());
+    for (size_t n : *order) {
+      entries.push_back(std::move(entries_[n]));
+      hashes.push_back(hashes_[n]);
+    }
+    entries_.swap(entries);
+    hashes_.swap(hashes);
+    rehash(slots_.size());
+    sorted_ = true;
+  }
+};
+
+/// Add a value to an element of a HashedMap (see add_to_map for std::map)
+template <class T, class F>
+void add_to_map(HashedMap<T, F> &m, const T &key, const F &value) {
+  // don't add a zero term
+  if (value == 0)
+    return;
+  m.add(key, value);
+}
+
+#endif // _wicked_hashed_map_h_
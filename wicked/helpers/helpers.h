@@ -1,6 +1,7 @@
 #ifndef _wicked_helpers_h_
 #define _wicked_helpers_h_
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <numeric>
@@ -31,6 +32,12 @@ template <class T> std::vector<T> iota_vector(size_t size, T value = T(0)) {
   return v;
 }
 
+/// Combine a hash value with the hash of another object (a 64-bit version of
+/// boost::hash_combine)
+inline std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 12) + (seed >> 4));
+}
+
 /// A range iterator class used to loop over
 class int_matrix {
 private:
@@ -0,0 +1,100 @@
+#ifndef _wicked_parallel_h_
+#define _wicked_parallel_h_
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Run a function over a range of tasks using a pool of threads
+ *
+ * Calls func(task, thread) for task = 0, 1, ..., ntasks - 1. The thread
+ * argument (0, ..., nthreads - 1) can be used by the caller to index
+ * per-thread scratch space.
+ *
+ * Tasks are scheduled by work stealing: each thread owns a queue that is
+ * initially filled with a contiguous block of tasks. A thread takes tasks from
+ * the front of its own queue and, once it runs out of work, steals tasks from
+ * the back of the queues of the other threads. This balances the load when
+ * the cost of the tasks is very uneven.
+ *
+ * If a task throws, the remaining tasks are skipped and the first exception is
+ * rethrown in the calling thread.
+ */
+template <class F> void parallel_for(int ntasks, int nthreads, F &&func) {
+  nthreads = std::max(1, std::min(nthreads, ntasks));
+  if (nthreads == 1) {
+    for (int task = 0; task < ntasks; task++) {
+      func(task, 0);
+    }
+    return;
+  }
+
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+  std::vector<TaskQueue> queues(nthreads);
+  for (int task = 0; task < ntasks; task++) {
+    queues[(static_cast<long>(task) * nthreads) / ntasks].tasks.push_back(task);
+  }
+
+  // return the next task for a thread or -1 if there is no work left
+  auto next_task = [&](int thread) {
+    {
+      std::lock_guard<std::mutex> lock(queues[thread].mutex);
+      if (not queues[thread].tasks.empty()) {
+        int task = queues[thread].tasks.front();
+        queues[thread].tasks.pop_front();
+        return task;
+      }
+    }
+    for (int i = 1; i < nthreads; i++) {
+      auto &victim = queues[(thread + i) % nthreads];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (not victim.tasks.empty()) {
+        int task = victim.tasks.back();
+        victim.tasks.pop_back();
+        return task;
+      }
+    }
+    return -1;
+  };
+
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&](int thread) {
+    for (int task = next_task(thread); (task >= 0) and (not failed);
+         task = next_task(thread)) {
+      try {
+        func(task, thread);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (not error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int thread = 1; thread < nthreads; thread++) {
+    threads.emplace_back(worker, thread);
+  }
+  worker(0);
+  for (auto &t : threads) {
+    t.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+#endif // _wicked_parallel_h_
@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <limits>
 #include <numeric>
 #include <regex>
+#include <stdexcept>
 
 #if USE_BOOST_1024_INT
 #include "boost/lexical_cast.hpp"
@@ -7,148 +13,296 @@
 
 #include "rational.h"
 
-rational::rational() : numerator_(0), denominator_(1) {}
+namespace {
+constexpr std::int64_t int64_min = std::numeric_limits<std::int64_t>::min();
+constexpr std::int64_t int64_max = std::numeric_limits<std::int64_t>::max();
 
-rational::rational(int numerator) {
-  numerator_ = numerator;
-  denominator_ = 1;
+/// the relative tolerance used to compare floating-point numbers
+constexpr double floating_point_tolerance = 1.0e-12;
+
+/// store the result of the arithmetic operations as a double? It is read by
+/// every arithmetic operation, also on the threads of a contraction
+std::atomic<bool> use_floating_point(false);
+
+bool equal_doubles(double a, double b) {
+  // the relative tolerance is infinite if a or b is
+  if (not(std::isfinite(a) and std::isfinite(b)))
+    return a == b;
+  return std::fabs(a - b) <=
+         floating_point_tolerance *
+             std::max({1.0, std::fabs(a), std::fabs(b)});
+}
+
+/// the greatest common divisor of two 128-bit integers
+unsigned __int128 gcd(unsigned __int128 a, unsigned __int128 b) {
+  if (((a >> 64) == 0) and ((b >> 64) == 0)) {
+    return std::gcd(static_cast<std::uint64_t>(a),
+                    static_cast<std::uint64_t>(b));
+  }
+  while (b != 0) {
+    const unsigned __int128 r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
 }
 
+/// does a number fit in a 64-bit integer?
+template <class T> bool fits_int64(const T &n) {
+  return (n >= int64_min) and (n <= int64_max);
+}
+
+#if not USE_BOOST_1024_INT
+[[noreturn]] void throw_overflow(const std::string &func) {
+  throw std::runtime_error(func + " - integer overflow (wicked must be compiled "
+                                  "with boost to use 1024-bit integers)");
+}
+#endif
+
+std::string to_string(const rational_t &n) {
+#if USE_BOOST_1024_INT
+  if (fits_int64(n))
+    return std::to_string(static_cast<std::int64_t>(n));
+  return boost::lexical_cast<std::string>(n);
+#else
+  return std::to_string(n);
+#endif
+}
+
+std::string to_string(double x) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.12g", x);
+  return buffer;
+}
+} // namespace
+
+rational::rational() {}
+
+rational::rational(int numerator) : numerator_(numerator) {}
+
 rational::rational(rational_t numerator) {
-  numerator_ = numerator;
-  denominator_ = 1;
+  if (fits_int64(numerator)) {
+    numerator_ = static_cast<std::int64_t>(numerator);
+  } else {
+    set_big(numerator, 1);
+  }
 }
 
 rational::rational(rational_t numerator, rational_t denominator) {
-  // enforce a positive denominator
-  numerator_ = denominator < 0 ? -numerator : numerator;
-  denominator_ = denominator < 0 ? -denominator : denominator;
-  // bring to canonical form
-  reduce();
+  if (fits_int64(numerator) and fits_int64(denominator)) {
+    set(static_cast<std::int64_t>(numerator),
+        static_cast<std::int64_t>(denominator));
+  } else {
+    set_big(numerator, denominator);
+  }
 }
 
-rational_t rational::numerator() const { return numerator_; }
+rational_t rational::numerator() const {
+  if (is_floating_point()) {
+    throw std::runtime_error(
+        "rational::numerator - the number is a floating-point value");
+  }
+  return big_ ? big_->first : rational_t(numerator_);
+}
 
-rational_t rational::denominator() const { return denominator_; }
+rational_t rational::denominator() const {
+  if (is_floating_point()) {
+    throw std::runtime_error(
+        "rational::denominator - the number is a floating-point value");
+  }
+  return big_ ? big_->second : rational_t(denominator_);
+}
 
 double rational::to_double() const {
+  if (is_floating_point()) {
+    return value_;
+  }
+  if (not big_) {
+    return static_cast<double>(numerator_) / static_cast<double>(denominator_);
+  }
   return static_cast<double>(numerator()) / static_cast<double>(denominator());
 }
 
 rational operator+(rational rhs) { return rhs; }
 
 rational operator-(rational rhs) {
-  return rational(-rhs.numerator(), rhs.denominator());
+  if (rhs.is_floating_point()) {
+    rhs.value_ = -rhs.value_;
+  } else if (rhs.big_) {
+    rhs.set_big(-rhs.big_->first, rhs.big_->second);
+  } else if (rhs.numerator_ == int64_min) {
+    rhs.set(-static_cast<__int128>(rhs.numerator_), rhs.denominator_);
+  } else {
+    rhs.numerator_ = -rhs.numerator_;
+  }
+  return rhs;
 }
 
 rational &rational::operator+=(const rational &rhs) {
-  numerator_ = rhs.denominator_ * numerator_ + rhs.numerator_ * denominator_;
-  denominator_ = rhs.denominator_ * denominator_;
-  reduce();
+  if (floating_point_result(rhs)) {
+    set_floating_point(to_double() + rhs.to_double());
+    return *this;
+  }
+  if (not(big_ or rhs.big_)) {
+    // the products are smaller than 2^126 in magnitude, but their sum may
+    // overflow
+    __int128 numerator;
+    if (not __builtin_add_overflow(
+            static_cast<__int128>(numerator_) * rhs.denominator_,
+            static_cast<__int128>(rhs.numerator_) * denominator_,
+            &numerator)) {
+      set(numerator, static_cast<__int128>(denominator_) * rhs.denominator_);
+      return *this;
+    }
+#if not USE_BOOST_1024_INT
+    throw_overflow("rational::operator+=");
+#endif
+  }
+  const auto [n, d] = to_big();
+  const auto [rhs_n, rhs_d] = rhs.to_big();
+  set_big(rhs_d * n + rhs_n * d, rhs_d * d);
   return *this;
 }
 
 rational &rational::operator-=(const rational &rhs) {
-  numerator_ = rhs.denominator_ * numerator_ - rhs.numerator_ * denominator_;
-  denominator_ = rhs.denominator_ * denominator_;
-  reduce();
+  if (floating_point_result(rhs)) {
+    set_floating_point(to_double() - rhs.to_double());
+    return *this;
+  }
+  if (not(big_ or rhs.big_)) {
+    __int128 numerator;
+    if (not __builtin_sub_overflow(
+            static_cast<__int128>(numerator_) * rhs.denominator_,
+            static_cast<__int128>(rhs.numerator_) * denominator_,
+            &numerator)) {
+      set(numerator, static_cast<__int128>(denominator_) * rhs.denominator_);
+      return *this;
+    }
+#if not USE_BOOST_1024_INT
+    throw_overflow("rational::operator-=");
+#endif
+  }
+  const auto [n, d] = to_big();
+  const auto [rhs_n, rhs_d] = rhs.to_big();
+  set_big(rhs_d * n - rhs_n * d, rhs_d * d);
   return *this;
 }
 
 rational &rational::operator*=(const rational &rhs) {
-  numerator_ *= rhs.numerator();
-  denominator_ *= rhs.denominator();
-  reduce();
+  if (floating_point_result(rhs)) {
+    set_floating_point(to_double() * rhs.to_double());
+    return *this;
+  }
+  if (not(big_ or rhs.big_)) {
+    set(static_cast<__int128>(numerator_) * rhs.numerator_,
+        static_cast<__int128>(denominator_) * rhs.denominator_);
+    return *this;
+  }
+  const auto [n, d] = to_big();
+  const auto [rhs_n, rhs_d] = rhs.to_big();
+  set_big(n * rhs_n, d * rhs_d);
   return *this;
 }
 
 rational &rational::operator/=(const rational &rhs) {
-  numerator_ *= rhs.denominator();
-  denominator_ *= rhs.numerator();
-  reduce();
+  if (floating_point_result(rhs)) {
+    const double rhs_value = rhs.to_double();
+    if (rhs_value == 0.0) {
+      throw std::runtime_error("rational::operator/= - division by zero");
+    }
+    set_floating_point(to_double() / rhs_value);
+    return *this;
+  }
+  if (not(big_ or rhs.big_)) {
+    set(static_cast<__int128>(numerator_) * rhs.denominator_,
+        static_cast<__int128>(denominator_) * rhs.numerator_);
+    return *this;
+  }
+  const auto [n, d] = to_big();
+  const auto [rhs_n, rhs_d] = rhs.to_big();
+  set_big(n * rhs_d, d * rhs_n);
   return *this;
 }
 
 std::string rational::str(bool sign) const {
+  if (is_floating_point()) {
+    if (equal_doubles(value_, 0.0))
+      return "0";
+    if (equal_doubles(value_, 1.0))
+      return sign ? "+" : "";
+    if (equal_doubles(value_, -1.0))
+      return "-";
+    return ((sign and (value_ > 0.0)) ? "+" : "") + to_string(value_);
+  }
+  const rational_t numerator = this->numerator();
+  const rational_t denominator = this->denominator();
   std::string s;
-  if (numerator_ == 0) {
+  if (numerator == 0) {
     s = "0";
   } else {
-    if (sign and (numerator_ > 0)) {
+    if (sign and (numerator > 0)) {
       s = '+';
     }
-    if (denominator_ == 1) {
-      if (numerator_ == -1) {
+    if (denominator == 1) {
+      if (numerator == -1) {
         s += "-";
       } else {
-        if (numerator_ != 1) {
-#if USE_BOOST_1024_INT
-          s += boost::lexical_cast<std::string>(numerator_);
-#else
-          s += std::to_string(numerator_);
-#endif
+        if (numerator != 1) {
+          s += to_string(numerator);
         }
       }
     } else {
-#if USE_BOOST_1024_INT
-      s += boost::lexical_cast<std::string>(numerator_) + "/" +
-           boost::lexical_cast<std::string>(denominator_);
-#else
-      s += std::to_string(numerator_) + "/" + std::to_string(denominator_);
-#endif
+      s += to_string(numerator) + "/" + to_string(denominator);
     }
   }
   return s;
 }
 
 std::string rational::repr() const {
-#if USE_BOOST_1024_INT
-  return "rational(" + boost::lexical_cast<std::string>(numerator_) + "," +
-         boost::lexical_cast<std::string>(denominator_) + ")";
-#else
-  return "rational(" + std::to_string(numerator_) + "," +
-         std::to_string(denominator_) + ")";
-#endif
+  if (is_floating_point()) {
+    return "rational(" + to_string(value_) + ")";
+  }
+  return "rational(" + to_string(numerator()) + "," +
+         to_string(denominator()) + ")";
 }
 
 std::string rational::latex() const {
+  if (is_floating_point()) {
+    if (equal_doubles(value_, 0.0))
+      return "0";
+    if (equal_doubles(std::fabs(value_), 1.0))
+      return value_ > 0.0 ? "+" : "-";
+    return (value_ > 0.0 ? "+" : "-") + to_string(std::fabs(value_));
+  }
+  const rational_t numerator = this->numerator();
+  const rational_t denominator = this->denominator();
   std::string s;
-  if (numerator_ == 0) {
+  if (numerator == 0) {
     s = "0";
   } else {
-    if (denominator_ == 1) {
-      if (numerator_ == 1) {
+    if (denominator == 1) {
+      if (numerator == 1) {
         s += "+";
-      } else if (numerator_ == -1) {
+      } else if (numerator == -1) {
         s += "-";
       } else {
-#if USE_BOOST_1024_INT
-        s += boost::lexical_cast<std::string>(numerator_);
-#else
-        s += std::to_string(numerator_);
-#endif
+        s += to_string(numerator);
       }
     } else {
-      if (numerator_ > 0) {
+      if (numerator > 0) {
         s += "+";
       } else {
         s += "-";
       }
-#if USE_BOOST_1024_INT
-      s += "\\frac{" + boost::lexical_cast<std::string>(abs(numerator_)) +
-           "}{" + boost::lexical_cast<std::string>(denominator_) + "}";
-#else
-      s += "\\frac{" + std::to_string(std::abs(numerator_)) + "}{" +
-           std::to_string(denominator_) + "}";
-#endif
+      s += "\\frac{" + to_string(numerator > 0 ? numerator : -numerator) +
+           "}{" + to_string(denominator) + "}";
     }
   }
   return s;
 }
 
 std::string rational::compile(const std::string &format) const {
-  return std::to_string(static_cast<double>(numerator_) /
-                        static_cast<double>(denominator_));
+  return std::to_string(to_double());
 }
 
 rational operator+(rational lhs, const rational &rhs) {
@@ -172,10 +326,16 @@ rational operator/(rational lhs, const rational &rhs) {
 }
 
 bool operator==(const rational &lhs, const rational &rhs) {
-  if ((lhs.numerator() == 0) and (rhs.numerator() == 0))
+  if (lhs.is_floating_point() or rhs.is_floating_point()) {
+    return equal_doubles(lhs.to_double(), rhs.to_double());
+  }
+  if (lhs.big_ or rhs.big_) {
+    return lhs.to_big() == rhs.to_big();
+  }
+  if ((lhs.numerator_ == 0) and (rhs.numerator_ == 0))
     return true;
-  return ((lhs.numerator() == rhs.numerator()) and
-          (lhs.denominator() == rhs.denominator()));
+  return ((lhs.numerator_ == rhs.numerator_) and
+          (lhs.denominator_ == rhs.denominator_));
 }
 
 bool operator!=(const rational &lhs, const rational &rhs) {
@@ -187,18 +347,85 @@ std::ostream &operator<<(std::ostream &os, const rational &rhs) {
   return os;
 }
 
-void rational::reduce() {
-// find the gcd
+void rational::set(__int128 numerator, __int128 denominator) {
+  // a zero denominator marks floating-point numbers, so it is never stored
+  if (denominator == 0) {
+    throw std::runtime_error("rational::set - division by zero");
+  }
+  // enforce a positive denominator
+  if (denominator < 0) {
+    numerator = -numerator;
+    denominator = -denominator;
+  }
+  // bring to canonical form
+  if (denominator != 1) {
+    const unsigned __int128 abs_numerator =
+        numerator < 0 ? -static_cast<unsigned __int128>(numerator)
+                      : static_cast<unsigned __int128>(numerator);
+    const __int128 gcd = ::gcd(abs_numerator, denominator);
+    if (gcd > 1) {
+      numerator /= gcd;
+      denominator /= gcd;
+    }
+  }
+  if (fits_int64(numerator) and fits_int64(denominator)) {
+    numerator_ = static_cast<std::int64_t>(numerator);
+    denominator_ = static_cast<std::int64_t>(denominator);
+    big_.reset();
+    return;
+  }
 #if USE_BOOST_1024_INT
-  rational_t gcd = boost::gcd(numerator_, denominator_);
+  set_big(rational_t(numerator), rational_t(denominator));
 #else
-  rational_t gcd = std::gcd(numerator_, denominator_);
+  throw_overflow("rational::set");
 #endif
-  // divide numerator and denominator by the gcd
+}
+
+void rational::set_big(rational_t numerator, rational_t denominator) {
+#if USE_BOOST_1024_INT
+  if (denominator == 0) {
+    throw std::runtime_error("rational::set_big - division by zero");
+  }
+  // enforce a positive denominator
+  if (denominator < 0) {
+    numerator = -numerator;
+    denominator = -denominator;
+  }
+  // bring to canonical form
+  rational_t gcd = boost::gcd(numerator, denominator);
   if (gcd > 1) {
-    numerator_ /= gcd;
-    denominator_ /= gcd;
+    numerator /= gcd;
+    denominator /= gcd;
   }
+  // go back to 64-bit integers if possible
+  if (fits_int64(numerator) and fits_int64(denominator)) {
+    numerator_ = static_cast<std::int64_t>(numerator);
+    denominator_ = static_cast<std::int64_t>(denominator);
+    big_.reset();
+    return;
+  }
+  numerator_ = 0;
+  denominator_ = 1;
+  big_ = std::make_shared<const big_t>(numerator, denominator);
+#else
+  // rational_t has 64 bits, so all numbers are stored in the 64-bit form
+  set(numerator, denominator);
+#endif
+}
+
+void rational::set_floating_point(double value) {
+  value_ = value;
+  denominator_ = 0;
+  big_.reset();
+}
+
+bool rational::floating_point_result(const rational &rhs) const {
+  return use_floating_point.load(std::memory_order_relaxed) or
+         is_floating_point() or rhs.is_floating_point();
+}
+
+rational::big_t rational::to_big() const {
+  return big_ ? *big_ : big_t(numerator_, denominator_);
 }
 
 #include <iostream>
@@ -240,4 +467,12 @@ rational make_rational_from_str(const std::string &s) {
 bool use_boost_1024_int() { return true; }
 #else
 bool use_boost_1024_int() { return false; }
-#endif
\ No newline at end of file
+#endif
+
+void set_floating_point_coefficients(bool val) {
+  use_floating_point.store(val, std::memory_order_relaxed);
+}
+
+bool floating_point_coefficients() {
+  return use_floating_point.load(std::memory_order_relaxed);
+}
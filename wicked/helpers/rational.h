@@ -1,7 +1,10 @@
 #ifndef _wicked_rational_h_
 #define _wicked_rational_h_
 
+#include <cstdint>
+#include <memory>
 #include <ostream>
+#include <utility>
 
 /// USE_BOOST_1024_INT is set to true by CMake if boost is found
 /// otherwise, we use long long int.
@@ -17,12 +20,25 @@ using rational_t = long long int;
 #endif
 
 /// A class for rational numbers
+///
+/// The numerator and denominator are stored as 64-bit integers and the
+/// arithmetic is done with overflow-checked 128-bit integers. A number that does
+/// not fit in 64-bit integers is stored as a pair of rational_t (1024-bit
+/// integers when boost is used) and it goes back to the 64-bit form as soon as
+/// it fits again. Without boost, an overflow throws an exception.
+///
+/// When floating-point coefficients are enabled (see
+/// set_floating_point_coefficients), the result of the arithmetic operations is
+/// stored as a double. This skips the exact arithmetic for the workloads that
+/// only need approximate coefficients. Floating-point numbers are compared with
+/// a relative tolerance of 1e-12.
 class rational {
 
 public:
   /// initialize with zero
   rational();
-  /// initialize with rational (numerator/denominator)
+  /// initialize with rational (numerator/denominator). Throws if the
+  /// denominator is zero
   rational(rational_t numerator, rational_t denominator);
   /// initialize with integer (numerator)
   rational(rational_t numerator);
@@ -34,6 +50,8 @@ public:
   rational_t denominator() const;
   /// return this converted to a double
   double to_double() const;
+  /// return true if this number is stored as a double
+  bool is_floating_point() const { return denominator_ == 0; }
   /// return a (nice) string representation, and optionally show the sign
   std::string str(bool sign = false) const;
   /// return a string representation
@@ -49,26 +67,46 @@ public:
   rational &operator-=(const rational &rhs);
   /// multiplication assignment
   rational &operator*=(const rational &rhs);
-  /// division assignment
+  /// division assignment. Throws if rhs is zero
   rational &operator/=(const rational &rhs);
 
+  /// equal to
+  friend bool operator==(const rational &lhs, const rational &rhs);
+  /// unary minus
+  friend rational operator-(rational rhs);
+
 private:
-  /// the numerator
-  rational_t numerator_;
-  /// the denominator
-  rational_t denominator_;
-  /// reduce the rational number
-  void reduce();
+  using big_t = std::pair<rational_t, rational_t>;
+
+  union {
+    /// the numerator
+    std::int64_t numerator_ = 0;
+    /// the value of a floating-point number
+    double value_;
+  };
+  /// the denominator (always positive), or zero for a floating-point number
+  std::int64_t denominator_ = 1;
+  /// the numerator and denominator of a number that does not fit in 64-bit
+  /// integers (nullptr otherwise). The pair is never modified, so it can be
+  /// shared by copies
+  std::shared_ptr<const big_t> big_;
+
+  /// set this number to numerator/denominator (reduced to canonical form)
+  void set(__int128 numerator, __int128 denominator);
+  /// set this number to numerator/denominator (reduced to canonical form)
+  void set_big(rational_t numerator, rational_t denominator);
+  /// set this number to a floating-point value
+  void set_floating_point(double value);
+  /// return true if an operation with rhs gives a floating-point number
+  bool floating_point_result(const rational &rhs) const;
+  /// return this number as a pair of rational_t
+  big_t to_big() const;
 };
 
-/// equal to
-bool operator==(const rational &lhs, const rational &rhs);
 /// not equal to
 bool operator!=(const rational &lhs, const rational &rhs);
 /// unary plus
 rational operator+(rational rhs);
-/// unary minus
-rational operator-(rational rhs);
 /// addition
 rational operator+(rational lhs, const rational &rhs);
 /// subtraction
@@ -83,5 +121,11 @@ rational make_rational_from_str(const std::string &s);
 std::ostream &operator<<(std::ostream &os, const rational &rhs);
 /// return true if boost rational is used
 bool use_boost_1024_int();
+/// Enable/disable floating-point coefficients. When enabled, the result of an
+/// arithmetic operation between rationals is stored as a double. Changing this
+/// option while a WickTheorem::contract() call is running is not supported
+void set_floating_point_coefficients(bool val);
+/// Return true if floating-point coefficients are enabled
+bool floating_point_coefficients();
 
 #endif // _wicked_rational_h_
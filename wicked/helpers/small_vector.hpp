@@ -0,0 +1,152 @@
+#ifndef _wicked_small_vector_h_
+#define _wicked_small_vector_h_
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+/// A vector that stores up to N elements inside the object and allocates
+/// memory on the heap only when it grows beyond that. It is used for short
+/// sequences (e.g., the indices of a tensor) that are stored in large numbers,
+/// where a std::vector would require an allocation for each object.
+///
+/// Only trivially copyable element types are supported.
+template <class T, size_t N> class small_vector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "small_vector requires a trivially copyable type");
+
+public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  small_vector() {}
+  small_vector(std::initializer_list<T> elements) {
+    assign(elements.begin(), elements.end());
+  }
+  small_vector(const std::vector<T> &elements) {
+    assign(elements.data(), elements.data() + elements.size());
+  }
+  small_vector(const small_vector &other) {
+    assign(other.begin(), other.end());
+  }
+  small_vector(small_vector &&other) { move_from(other); }
+  ~small_vector() { release(); }
+
+  small_vector &operator=(const small_vector &other) {
+    if (this != &other) {
+      assign(other.begin(), other.end());
+    }
+    return *this;
+  }
+  small_vector &operator=(small_vector &&other) {
+    if (this != &other) {
+      release();
+      move_from(other);
+    }
+    return *this;
+  }
+
+  /// Convert to a std::vector
+  operator std::vector<T>() const { return std::vector<T>(begin(), end()); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  T *data() { return on_heap() ? heap_ : inline_; }
+  const T *data() const { return on_heap() ? heap_ : inline_; }
+
+  T &operator[](size_t n) { return data()[n]; }
+  const T &operator[](size_t n) const { return data()[n]; }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+
+  /// Add an element at the end
+  void push_back(const T &e) {
+    if (size_ == capacity_) {
+      const T copy = e; // e may be an element of this vector
+      reserve(2 * capacity_);
+      data()[size_++] = copy;
+      return;
+    }
+    data()[size_++] = e;
+  }
+
+  /// Replace the elements with those of the range [first, last)
+  void assign(const T *first, const T *last) {
+    const size_t n = last - first;
+    if (n > capacity_) {
+      release();
+      heap_ = new T[n];
+      capacity_ = n;
+    }
+    std::copy(first, last, data());
+    size_ = n;
+  }
+
+  /// Make room for at least n elements
+  void reserve(size_t n) {
+    if (n <= capacity_)
+      return;
+    T *heap = new T[n];
+    std::copy(begin(), end(), heap);
+    const std::uint32_t size = size_;
+    release();
+    heap_ = heap;
+    capacity_ = n;
+    size_ = size;
+  }
+
+  bool operator==(const small_vector &other) const {
+    return std::equal(begin(), end(), other.begin(), other.end());
+  }
+  bool operator!=(const small_vector &other) const {
+    return not(*this == other);
+  }
+  /// Lexicographical comparison (as for std::vector)
+  bool operator<(const small_vector &other) const {
+    return std::lexicographical_compare(begin(), end(), other.begin(),
+                                        other.end());
+  }
+  bool operator>(const small_vector &other) const { return other < *this; }
+
+private:
+  bool on_heap() const { return capacity_ > N; }
+
+  /// Free the heap memory (if any) and go back to the inline storage
+  void release() {
+    if (on_heap()) {
+      delete[] heap_;
+    }
+    capacity_ = N;
+    size_ = 0;
+  }
+
+  /// Take the elements of another vector, which is left empty
+  void move_from(small_vector &other) {
+    if (other.on_heap()) {
+      heap_ = other.heap_;
+      capacity_ = other.capacity_;
+      size_ = other.size_;
+      other.capacity_ = N;
+      other.size_ = 0;
+    } else {
+      assign(other.begin(), other.end());
+    }
+  }
+
+  /// the elements are stored inline when they fit, otherwise on the heap
+  union {
+    T inline_[N];
+    T *heap_ = nullptr;
+  };
+  std::uint32_t size_ = 0;
+  std::uint32_t capacity_ = N;
+};
+
+#endif // _wicked_small_vector_h_